@@ -23,102 +23,483 @@
 #include "catalog/pg_attribute.h"
 #endif
 
+/*
+ * Relations can't have more attributes than this (MaxTupleAttributeNumber),
+ * so a larger relnatts value is corrupt, and the attribute summary doesn't
+ * try to cover it.
+ */
+#define MAX_SUMMARIZED_ATTNUM	1664
+
 typedef struct
 {
 	pg_catalog_table *pg_class;
+	attribute_summary *summary;
+	int		   *class_rownum;	/* pg_class row for each row, if summarized */
 	int			attrelid_result_column;
 	int			relnatts_result_column;
+	long		min_attno;
 } attnum_cache;
 
+/* What the attribute summary knows about one pg_class row. */
+typedef struct
+{
+	long		relnatts;		/* relnatts, or -1 if not a valid count */
+	int			nbits;			/* attribute numbers covered by the bitmap,
+								 * or -1 if the row isn't summarized */
+	int			npresent;		/* ... of which, how many are present */
+	uint32		word;			/* offset of first bitmap word */
+} class_summary;
+
+/*
+ * A summary of pg_attribute built in a single pass, so that relnatts and
+ * attnum can be checked against each other without a hash probe for every
+ * attribute number.  The summary is indexed by pg_class row number, and
+ * records which of each relation's attribute numbers from 1 to relnatts are
+ * present.  The matching pg_class row for each row of pg_attribute comes from
+ * the join index on attrelid.
+ */
+struct attribute_summary
+{
+	class_summary *classes;		/* one per pg_class row */
+	uint64	   *bits;			/* attribute numbers present */
+};
+
+static inline bool check_attnum_range(pg_catalog_table *tab,
+				   pg_catalog_column *tabcol, attnum_cache *cache,
+				   int rownum, long *attnum);
+static int lookup_class_row(pg_catalog_table *pg_class, colstore *store,
+				 int rownum, int colno);
+static bool get_integer_value(colstore *store, int rownum, int colno,
+				  long *result);
+static attribute_summary *build_attribute_summary(pg_catalog_table *pg_class,
+						pg_catalog_table *pg_attribute);
+static void check_attnum_kernel(check_step *step, pg_catalog_table *tab,
+					int start, int end);
+static void check_attnum_relnatts_kernel(check_step *step,
+							 pg_catalog_table *tab, int start, int end);
+static void check_attnum_summary_kernel(check_step *step,
+							pg_catalog_table *tab, int start, int end);
+
 /*
  * Set up to check attnum.
  */
 void
 prepare_to_check_attnum(pg_catalog_table *tab, pg_catalog_column *tabcol)
 {
-	add_table_dependency(tab, find_table_by_name("pg_class"));
+	pg_catalog_table *pg_class = find_table_by_name("pg_class");
+
+	/* We need the relnatts value from the matching pg_class row. */
+	add_table_dependency(tab, pg_class);
+	pg_class->needs_rows = true;
+	find_column_by_name(pg_class, "relnatts")->needed = true;
+	request_attribute_summary();
 }
 
 /*
- * Sanity-check the relnatts field.
+ * Compile an attnum check into a plan step.
  */
-void
-check_attnum(pg_catalog_table *tab, pg_catalog_column *tabcol, int rownum)
+bool
+bind_attnum_check(pg_catalog_table *tab, pg_catalog_column *tabcol,
+				  check_step *step)
 {
-	char	   *val = PQgetvalue(tab->data, rownum, tabcol->result_column);
-	char	   *attrelid_val;
-	char	   *relnatts_val;
-	char	   *endptr;
 	attnum_cache *cache;
-	int			class_rownum;
+
+	cache = pg_malloc(sizeof(attnum_cache));
+	cache->pg_class = find_table_by_name("pg_class");
+	cache->summary = NULL;
+	cache->class_rownum = NULL;
+	cache->attrelid_result_column = colstore_fnumber(tab->store, "attrelid");
+	cache->relnatts_result_column = colstore_fnumber(cache->pg_class->store,
+											  "relnatts");
+
+	/* It should be at least -7 for PostgreSQL, -8 for EnterpriseDB. */
+	cache->min_attno = remote_is_edb ? -8 : -7;
+
+	tabcol->check_private = cache;
+	step->state = cache;
+
+	/*
+	 * Skip max-bound checking if the pg_class data is not available, or if
+	 * the pg_class.relnatts or pg_attribute.attrelid column is not available.
+	 */
+	if (cache->pg_class->ht == NULL || cache->relnatts_result_column == -1 ||
+		cache->attrelid_result_column == -1)
+		step->kernel = check_attnum_kernel;
+	else if ((cache->summary = get_attribute_summary()) != NULL &&
+			 (cache->class_rownum =
+			  get_join_index(tab, find_column_by_name(tab, "attrelid"))) != NULL)
+		step->kernel = check_attnum_summary_kernel;
+	else
+		step->kernel = check_attnum_relnatts_kernel;
+
+	return true;
+}
+
+/*
+ * Check the attnum field of each row, without reference to relnatts.
+ */
+static void
+check_attnum_kernel(check_step *step, pg_catalog_table *tab, int start,
+					int end)
+{
+	int			rownum;
 	long		attnum;
-	long		relnatts;
-	long		min_attno;
 
+	for (rownum = start; rownum < end; ++rownum)
+		check_attnum_range(tab, step->tabcol, step->state, rownum, &attnum);
+}
+
+/*
+ * Check the attnum field of each row, including that it doesn't exceed the
+ * relnatts value of the corresponding pg_class row.
+ */
+static void
+check_attnum_relnatts_kernel(check_step *step, pg_catalog_table *tab,
+							 int start, int end)
+{
+	attnum_cache *cache = step->state;
+	int			rownum;
+
+	for (rownum = start; rownum < end; ++rownum)
+	{
+		int			class_rownum;
+		long		attnum;
+		long		relnatts;
+
+		if (!check_attnum_range(tab, step->tabcol, cache, rownum, &attnum))
+			continue;
+
+		/* Find row number of this table in pg_class. */
+		class_rownum = lookup_class_row(cache->pg_class, tab->store, rownum,
+										cache->attrelid_result_column);
+		if (class_rownum == -1)
+			continue;			/* It's not our job to complain about
+								 * attrelid. */
+
+		/* Get relnatts, as a number. */
+		if (!get_integer_value(cache->pg_class->store, class_rownum,
+							   cache->relnatts_result_column, &relnatts) ||
+			relnatts < 0)
+			continue;			/* It's not our job to complain about
+								 * relnatts. */
+
+		/* Our attribute number should be less than relnatts. */
+		if (attnum > relnatts)
+			pgcc_report(tab, step->tabcol, rownum,
+						"exceeds relnatts value of %ld\n",
+						relnatts);
+	}
+}
+
+/*
+ * Like check_attnum_relnatts_kernel, but with the pg_class row and its
+ * relnatts value for each attribute already found by the attribute summary.
+ */
+static void
+check_attnum_summary_kernel(check_step *step, pg_catalog_table *tab,
+							int start, int end)
+{
+	attnum_cache *cache = step->state;
+	int			rownum;
+
+	for (rownum = start; rownum < end; ++rownum)
+	{
+		int			class_rownum;
+		long		attnum;
+		long		relnatts;
+
+		if (!check_attnum_range(tab, step->tabcol, cache, rownum, &attnum))
+			continue;
+
+		/* As above, complaints about attrelid and relnatts belong elsewhere. */
+		class_rownum = cache->class_rownum[rownum];
+		if (class_rownum == -1)
+			continue;
+		relnatts = cache->summary->classes[class_rownum].relnatts;
+		if (relnatts < 0)
+			continue;
+
+		/* Our attribute number should be less than relnatts. */
+		if (attnum > relnatts)
+			pgcc_report(tab, step->tabcol, rownum,
+						"exceeds relnatts value of %ld\n",
+						relnatts);
+	}
+}
+
+/*
+ * Sanity-check the attnum field on its own.  Returns true, with the value
+ * in *attnum, if it passes.
+ */
+static inline bool
+check_attnum_range(pg_catalog_table *tab, pg_catalog_column *tabcol,
+				   attnum_cache *cache, int rownum, long *attnum)
+{
 	/* Convert the value to a number. */
-	attnum = strtol(val, &endptr, 10);
-	if (*endptr != '\0')
+	if (!get_integer_value(tab->store, rownum, tabcol->result_column, attnum))
 	{
 		pgcc_report(tab, tabcol, rownum, "must be an integer\n");
-		return;
+		return false;
 	}
 
 	/* Our attribute number should not be zero. */
-	if (attnum == 0)
+	if (*attnum == 0)
 	{
 		pgcc_report(tab, tabcol, rownum, "must not be zero\n");
-		return;
+		return false;
 	}
 
 	/* And it should be at least -7 for PostgreSQL, -8 for EnterpriseDB. */
-	min_attno = remote_is_edb ? -8 : -7;
-	if (attnum < min_attno)
+	if (*attnum < cache->min_attno)
 	{
 		pgcc_report(tab, tabcol, rownum, "must be at least %ld\n",
-					min_attno);
-		return;
+					cache->min_attno);
+		return false;
 	}
 
-	/* Find the pg_attribute table; cache result in check_private. */
-	if (tabcol->check_private == NULL)
+	return true;
+}
+
+/*
+ * Fetch an integer value, accepting anything strtol() would.  Returns false
+ * if the value isn't an integer.
+ *
+ * Columns such as attnum and relnatts are stored as integers, so normally
+ * there's no text to parse.
+ */
+static bool
+get_integer_value(colstore *store, int rownum, int colno, long *result)
+{
+	uint32		value;
+	char	   *val;
+	char	   *endptr;
+
+	if (colstore_get_integer(store, rownum, colno, true, &value))
 	{
-		cache = pg_malloc(sizeof(attnum_cache));
-		cache->pg_class = find_table_by_name("pg_class");
-		cache->attrelid_result_column = PQfnumber(tab->data, "attrelid");
-		cache->relnatts_result_column = PQfnumber(cache->pg_class->data,
-												  "relnatts");
-		tabcol->check_private = cache;
+		*result = (int32) value;
+		return true;
 	}
-	else
-		cache = tabcol->check_private;
+
+	val = colstore_getvalue(store, rownum, colno);
+	*result = strtol(val, &endptr, 10);
+	return *endptr == '\0';
+}
+
+/*
+ * Find the pg_class row for the relation OID in the given column and row of
+ * some table, or -1 if there isn't one.
+ */
+static int
+lookup_class_row(pg_catalog_table *pg_class, colstore *store, int rownum,
+				 int colno)
+{
+	uint32		relid;
+	char	   *val;
+
+	if (colstore_get_integer(store, rownum, colno, false, &relid))
+		return pgrhash_get_integer(pg_class->ht, &relid);
+
+	val = colstore_getvalue(store, rownum, colno);
+	return pgrhash_get(pg_class->ht, &val);
+}
+
+/*
+ * Note that a check will want the attribute summary, which is built from the
+ * join index between pg_attribute and pg_class.
+ */
+void
+request_attribute_summary(void)
+{
+	pg_catalog_table *pg_attribute = find_table_by_name("pg_attribute");
+
+	request_join_index(pg_attribute,
+					   find_column_by_name(pg_attribute, "attrelid"),
+					   find_table_by_name("pg_class"));
+}
+
+/*
+ * Get the attribute summary, building it on first use.  Returns NULL if it
+ * can't be built yet: all of pg_class and pg_attribute must have been
+ * loaded, not just a block of either.
+ */
+attribute_summary *
+get_attribute_summary(void)
+{
+	static attribute_summary *summary = NULL;
+	pg_catalog_table *pg_class;
+	pg_catalog_table *pg_attribute;
+
+	if (summary != NULL)
+		return summary;
+
+	pg_class = find_table_by_name("pg_class");
+	pg_attribute = find_table_by_name("pg_attribute");
+	if (pg_class->store == NULL || pg_class->needs_load ||
+		pg_class->ht == NULL ||
+		pg_attribute->store == NULL || pg_attribute->needs_load)
+		return NULL;
+
+	summary = build_attribute_summary(pg_class, pg_attribute);
+	return summary;
+}
+
+/*
+ * Does the summary cover attribute numbers 1 through relnatts for the given
+ * pg_class row?
+ */
+bool
+attribute_summary_covers(attribute_summary *summary, int class_rownum,
+						 long relnatts)
+{
+	return relnatts <= summary->classes[class_rownum].nbits;
+}
+
+/*
+ * Find the first attribute number after attno, and no greater than relnatts,
+ * that pg_attribute lacks for the given pg_class row.  Returns 0 if there is
+ * none.  The summary must cover relnatts.
+ */
+int
+attribute_summary_next_missing(attribute_summary *summary, int class_rownum,
+							   long relnatts, int attno)
+{
+	class_summary *cls = &summary->classes[class_rownum];
+
+	/* Usually, every attribute is present. */
+	if (cls->npresent == cls->nbits)
+		return 0;
+
+	for (++attno; attno <= relnatts; ++attno)
+	{
+		int			bit = attno - 1;
+
+		if ((summary->bits[cls->word + bit / 64] &
+			 (UINT64CONST(1) << (bit % 64))) == 0)
+			return attno;
+	}
+
+	return 0;
+}
+
+/*
+ * Does pg_attribute have the given attribute number for the given pg_class
+ * row?  Returns TRI_DEFAULT if the summary can't say, in which case the
+ * caller must probe pg_attribute's hash table instead.
+ */
+enum trivalue
+attribute_summary_contains(attribute_summary *summary, int class_rownum,
+						   long attnum)
+{
+	class_summary *cls = &summary->classes[class_rownum];
+	int			bit;
+
+	if (attnum < 1 || attnum > cls->nbits)
+		return TRI_DEFAULT;
+
+	bit = attnum - 1;
+	if ((summary->bits[cls->word + bit / 64] &
+		 (UINT64CONST(1) << (bit % 64))) != 0)
+		return TRI_YES;
+	return TRI_NO;
+}
+
+/*
+ * Build the attribute summary.
+ *
+ * A pg_class row whose OID maps to some other row in the hash table (that
+ * is, a duplicate) isn't summarized, since no pg_attribute rows can be
+ * attributed to it; checks of such rows have to fall back to probing
+ * pg_attribute's own hash table.
+ */
+static attribute_summary *
+build_attribute_summary(pg_catalog_table *pg_class,
+						pg_catalog_table *pg_attribute)
+{
+	attribute_summary *summary;
+	int			oid_column = colstore_fnumber(pg_class->store, "oid");
+	int			relnatts_column = colstore_fnumber(pg_class->store,
+												   "relnatts");
+	int		   *class_rownums;
+	int			attnum_column = colstore_fnumber(pg_attribute->store,
+												 "attnum");
+	int			nclasses = colstore_nrows(pg_class->store);
+	int			nattributes = colstore_nrows(pg_attribute->store);
+	uint32		nwords = 0;
+	int			rownum;
+
+	if (oid_column == -1 || relnatts_column == -1 || attnum_column == -1)
+		return NULL;
+	class_rownums = get_join_index(pg_attribute,
+								   find_column_by_name(pg_attribute,
+													   "attrelid"));
+	if (class_rownums == NULL)
+		return NULL;
+
+	summary = pg_malloc(sizeof(attribute_summary));
+	summary->classes = pg_malloc(Max(nclasses, 1) * sizeof(class_summary));
+
+	/* Lay out a bitmap of attribute numbers 1..relnatts for each relation. */
+	for (rownum = 0; rownum < nclasses; ++rownum)
+	{
+		class_summary *cls = &summary->classes[rownum];
+
+		if (!get_integer_value(pg_class->store, rownum, relnatts_column,
+							   &cls->relnatts) || cls->relnatts < 0)
+			cls->relnatts = -1;
+
+		if (lookup_class_row(pg_class, pg_class->store, rownum,
+							 oid_column) != rownum)
+			cls->nbits = -1;
+		else
+			cls->nbits = (int) Min(Max(cls->relnatts, 0),
+								   MAX_SUMMARIZED_ATTNUM);
+		cls->npresent = 0;
+		cls->word = nwords;
+		nwords += (Max(cls->nbits, 0) + 63) / 64;
+	}
+	summary->bits = pg_malloc0(Max(nwords, 1) * sizeof(uint64));
 
 	/*
-	 * Skip max-bound checking if the pg_class data is not available, or if
-	 * the pg_class.relnatts or pg_attribute.attrelid column is not available.
+	 * Now make one pass over pg_attribute, marking each attribute's number
+	 * present for its pg_class row.  Only attribute numbers
+	 * stored in canonical form count, just as only those would match a
+	 * probe of pg_attribute's hash table.
 	 */
-	if (cache->pg_class->ht == NULL || cache->relnatts_result_column == -1 ||
-		cache->attrelid_result_column == -1)
-		return;
-
-	/* Find row number of this table in pg_class. */
-	attrelid_val = PQgetvalue(tab->data, rownum,
-							  cache->attrelid_result_column);
-	class_rownum = pgrhash_get(cache->pg_class->ht, &attrelid_val);
-	if (class_rownum == -1)
-		return;					/* It's not our job to complain about
-								 * attrelid. */
+	for (rownum = 0; rownum < nattributes; ++rownum)
+	{
+		class_summary *cls;
+		int			class_rownum;
+		uint32		value;
+		int32		attnum;
+		uint64	   *word;
+		uint64		mask;
 
-	/* Get relnatts, as a number. */
-	relnatts_val = PQgetvalue(cache->pg_class->data, class_rownum,
-							  cache->relnatts_result_column);
-	relnatts = strtol(relnatts_val, &endptr, 10);
-	if (*endptr != '\0' || relnatts < 0)
-		return;					/* It's not our job to complain about
-								 * relnatts. */
+		class_rownum = class_rownums[rownum];
+		if (class_rownum == -1)
+			continue;
+
+		cls = &summary->classes[class_rownum];
+		if (!colstore_get_integer(pg_attribute->store, rownum, attnum_column,
+								  true, &value))
+			continue;
+		attnum = (int32) value;
+		if (attnum < 1 || attnum > cls->nbits)
+			continue;
+
+		word = &summary->bits[cls->word + (attnum - 1) / 64];
+		mask = UINT64CONST(1) << ((attnum - 1) % 64);
+		if ((*word & mask) == 0)
+		{
+			*word |= mask;
+			cls->npresent++;
+		}
+	}
+
+	pgcc_log(PGCC_DEBUG,
+			 "summarized %d rows of pg_attribute for %d rows of pg_class in %lu bytes\n",
+			 nattributes, nclasses,
+			 (unsigned long) (nclasses * sizeof(class_summary) +
+							  nwords * sizeof(uint64)));
 
-	/* Our attribute number should be less than relnatts. */
-	if (attnum > relnatts)
-		pgcc_report(tab, tabcol, rownum,
-					"exceeds relnatts value of %ld\n",
-					relnatts);
+	return summary;
 }
@@ -13,9 +13,13 @@
 typedef struct
 {
 	pg_catalog_table *pg_attribute;
+	attribute_summary *summary;
 	int			oid_result_column;
 } relnatts_cache;
 
+static void check_relnatts_kernel(check_step *step, pg_catalog_table *tab,
+					  int start, int end);
+
 /*
  * Set up to check relnatts.
  */
@@ -23,62 +27,137 @@ void
 prepare_to_check_relnatts(pg_catalog_table *tab, pg_catalog_column *tabcol)
 {
 	add_table_dependency(tab, find_table_by_name("pg_attribute"));
+	request_attribute_summary();
 }
 
 /*
- * Sanity-check the relnatts field.
+ * Compile a relnatts check into a plan step.
  */
-void
-check_relnatts(pg_catalog_table *tab, pg_catalog_column *tabcol, int rownum)
+bool
+bind_relnatts_check(pg_catalog_table *tab, pg_catalog_column *tabcol,
+					check_step *step)
 {
-	char	   *val = PQgetvalue(tab->data, rownum, tabcol->result_column);
-	char	   *endptr;
 	relnatts_cache *cache;
-	long		relnatts;
-	int			attno;
-	char		buf[512];
-	char	   *keys[2];
-
-	/* Convert the value to a number. */
-	relnatts = strtol(val, &endptr, 10);
-	if (*endptr != '\0' || val < 0)
-		pgcc_report(tab, tabcol, rownum, "must be a non-negative integer\n");
-
-	/* Find the pg_attribute table; cache result in check_private. */
-	if (tabcol->check_private == NULL)
-	{
-		cache = pg_malloc(sizeof(relnatts_cache));
-		cache->pg_attribute = find_table_by_name("pg_attribute");
-		cache->oid_result_column = PQfnumber(tab->data, "oid");
-		tabcol->check_private = cache;
-	}
-	else
-		cache = tabcol->check_private;
+
+	cache = pg_malloc(sizeof(relnatts_cache));
+	cache->pg_attribute = find_table_by_name("pg_attribute");
+	cache->oid_result_column = colstore_fnumber(tab->store, "oid");
+	cache->summary = get_attribute_summary();
+	tabcol->check_private = cache;
+
+	step->state = cache;
+	step->kernel = check_relnatts_kernel;
+	return true;
+}
+
+/*
+ * Sanity-check the relnatts field.
+ */
+static void
+check_relnatts_kernel(check_step *step, pg_catalog_table *tab, int start,
+					  int end)
+{
+	pg_catalog_column *tabcol = step->tabcol;
+	relnatts_cache *cache = step->state;
+	bool		check_attributes;
+	int			rownum;
 
 	/*
 	 * Skip detailed checking if pg_attribute data is not available, or if the
 	 * oid column of pg_class is not available.
 	 */
-	if (cache->pg_attribute->ht == NULL || cache->oid_result_column == -1)
-		return;
-
-	/* Set up for pg_attribute hash table probes. */
-	keys[0] = PQgetvalue(tab->data, rownum, cache->oid_result_column);
-	keys[1] = buf;
+	check_attributes = (cache->pg_attribute->ht != NULL &&
+						cache->oid_result_column != -1);
 
-	/*
-	 * Check that all positive-numbered attributes we expect to find are in
-	 * fact present.
-	 *
-	 * TODO: We could check for negative-numbered attributes as well, but
-	 * whether or not those are present will depend on relkind inter alia.
-	 */
-	for (attno = 1; attno <= relnatts; ++attno)
+	for (rownum = start; rownum < end; ++rownum)
 	{
-		snprintf(buf, sizeof buf, "%d", attno);
-		if (pgrhash_get(cache->pg_attribute->ht, keys) == -1)
-			pgcc_report(tab, tabcol, rownum,
-						"attribute %d does not exist in pg_attribute\n",
-						attno);
+		long		relnatts;
+		int			attno;
+		char		buf[512];
+		char	   *keys[2];
+		uint32		key[2];
+		bool		integer_key;
+
+		/*
+		 * Convert the value to a number.  It's normally stored as one already;
+		 * if not, parse the text.
+		 */
+		if (colstore_get_integer(tab->store, rownum, tabcol->result_column,
+								 true, &key[1]))
+			relnatts = (int32) key[1];
+		else
+		{
+			char	   *val = colstore_getvalue(tab->store, rownum,
+												tabcol->result_column);
+			char	   *endptr;
+
+			relnatts = strtol(val, &endptr, 10);
+			if (*endptr != '\0' || val < 0)
+				pgcc_report(tab, tabcol, rownum,
+							"must be a non-negative integer\n");
+		}
+
+		if (!check_attributes)
+			continue;
+
+		/*
+		 * If the attribute summary covers this row, it can tell us directly
+		 * which attributes are missing, if any.
+		 */
+		if (cache->summary != NULL &&
+			attribute_summary_covers(cache->summary, rownum, relnatts))
+		{
+			attno = 0;
+			while ((attno = attribute_summary_next_missing(cache->summary,
+														   rownum, relnatts,
+														   attno)) != 0)
+				pgcc_report(tab, tabcol, rownum,
+							"attribute %d does not exist in pg_attribute\n",
+							attno);
+			continue;
+		}
+
+		/*
+		 * Set up for pg_attribute hash table probes.  The OID is normally
+		 * stored as an integer, and then we can probe without formatting each
+		 * attribute number as text.
+		 */
+		integer_key = colstore_get_integer(tab->store, rownum,
+										   cache->oid_result_column, false,
+										   &key[0]);
+		if (!integer_key)
+		{
+			keys[0] = colstore_getvalue(tab->store, rownum,
+										cache->oid_result_column);
+			keys[1] = buf;
+		}
+
+		/*
+		 * Check that all positive-numbered attributes we expect to find are
+		 * in fact present.
+		 *
+		 * TODO: We could check for negative-numbered attributes as well, but
+		 * whether or not those are present will depend on relkind inter
+		 * alia.
+		 */
+		for (attno = 1; attno <= relnatts; ++attno)
+		{
+			int			attrow;
+
+			if (integer_key)
+			{
+				key[1] = (uint32) attno;
+				attrow = pgrhash_get_integer(cache->pg_attribute->ht, key);
+			}
+			else
+			{
+				snprintf(buf, sizeof buf, "%d", attno);
+				attrow = pgrhash_get(cache->pg_attribute->ht, keys);
+			}
+			if (attrow == -1)
+				pgcc_report(tab, tabcol, rownum,
+							"attribute %d does not exist in pg_attribute\n",
+							attno);
+		}
 	}
 }
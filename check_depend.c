@@ -45,15 +45,92 @@ typedef struct check_depend_cache
 	int			class_result_column;
 	int			object_result_column;
 	int			deptype_result_column;
-	pgrhash	   *duplicate_owner_ht;
 } check_depend_cache;
 
+/*
+ * The class ID, object ID and sub-ID of one object reference are checked by
+ * a single plan step, so that each row's values are decoded and its class ID
+ * looked up just once for all three checks.  Columns of the triple that
+ * aren't being checked are NULL.
+ */
+typedef enum depend_triple_member
+{
+	TRIPLE_CLASS_ID,
+	TRIPLE_OBJECT_ID,
+	TRIPLE_SUBID
+} depend_triple_member;
+
+typedef struct depend_triple
+{
+	check_depend_cache *cache;	/* shared by all columns of the triple */
+	pg_catalog_column *class_col;
+	pg_catalog_column *object_col;
+	pg_catalog_column *subid_col;
+} depend_triple;
+
+/* One row's reference, as decoded for the checks of its triple. */
+typedef struct depend_row
+{
+	bool		class_valid;	/* is the class ID a well-formed OID? */
+	uint32		classid;
+	pg_catalog_table *object_tab;	/* catalog for class ID, or NULL */
+	bool		object_valid;	/* is the object ID a well-formed OID? */
+	uint32		objid;
+	int			object_rownum;	/* object's row in the object index, -1 if
+								 * not there, or -2 if not looked up */
+} depend_row;
+
+/*
+ * The owner dependencies seen so far, as a set of (database OID, class ID,
+ * object ID) keys packed into 96 bits, using open addressing with linear
+ * probing.  The set holds its own copies of the keys, not row numbers, so
+ * the rows can be discarded once they've been checked, and pg_shdepend can
+ * be streamed a block at a time like any other table nothing refers to.
+ */
+typedef struct owner_entry
+{
+	uint32		key[3];
+	bool		used;
+} owner_entry;
+
+typedef struct duplicate_owner_cache
+{
+	int			keycols[3];		/* dbid, classid and objid columns */
+	int			deptype_result_column;
+	uint32		nentries;		/* # of keys in the set */
+	uint32		size;			/* # of slots; a power of two */
+	owner_entry *entries;
+} duplicate_owner_cache;
+
+/*
+ * Graph checks of pg_depend.  A dependency of one of these types that's
+ * part of a cycle would prevent the objects involved from ever being
+ * dropped, and the objects that own others, directly or indirectly, through
+ * dependencies of the other types ought to exist all the way up.
+ */
+#define GRAPH_CYCLE_DEPTYPES		"na"
+#define GRAPH_OWNER_DEPTYPES		"iea"
+
+#define GRAPH_ROW_IN_CYCLE			0x01
+#define GRAPH_ROW_OWNER_MISSING		0x02
+
+typedef struct dependency_graph_cache
+{
+	uint8	   *row_flags;		/* GRAPH_ROW_* flags for each row */
+} dependency_graph_cache;
+
 typedef struct class_id_mapping_type
 {
-	char	   *oid;
+	Oid			oid;
 	pg_catalog_table *tab;
 } class_id_mapping_type;
 
+/*
+ * System catalogs are always created with OIDs below FirstNormalObjectId,
+ * so class IDs in that range are resolved with a directly indexed array.
+ */
+#define CLASS_ID_DIRECT_LIMIT		16384
+
 /*
  * EnterpriseDB versions prior to 9.4 are expected to have a number of
  * dangling dependency entries, unless initialized with --no-redwood-compat.
@@ -116,18 +193,96 @@ exception_list edb93_exception_list[] = {
 static bool class_id_mappings_attempted;
 static int	num_class_id_mapping;
 static class_id_mapping_type *class_id_mapping;
-static char *pg_class_oid;
+static int16 *class_id_direct;	/* index into class_id_mapping, or -1 */
+static Oid	pg_class_oid = InvalidOid;
+static bool object_index_attempted;
+static objaddr_index *object_index;
 static pg_catalog_table *pg_attribute_table;
+static attribute_summary *pg_attribute_summary;
 static pg_catalog_table *pg_type_table;
 
-static pg_catalog_table *lookup_class_id(char *oid);
+static pg_catalog_table *lookup_class_id(Oid oid);
 static void build_class_id_mappings(void);
+static void build_object_index(void);
 static bool table_key_is_oid(pg_catalog_table *tab);
 static check_depend_cache *build_depend_cache(pg_catalog_table *tab,
 				   pg_catalog_column *tabcol);
-static bool not_for_this_database(check_depend_cache *cache,
-					  pg_catalog_table *tab, pg_catalog_column *tabcol,
-					  int rownum);
+static bool not_for_this_database(int database_result_column,
+					  pg_catalog_table *tab, int rownum);
+static bool bind_depend_triple(pg_catalog_table *tab,
+				   pg_catalog_column *tabcol, check_step *step,
+				   check_depend_cache *cache, depend_triple_member member);
+static inline void check_dependency_class_id(pg_catalog_table *tab,
+						  pg_catalog_column *tabcol,
+						  check_depend_cache *cache, int rownum,
+						  depend_row *row);
+static inline void check_dependency_id(pg_catalog_table *tab,
+					pg_catalog_column *tabcol,
+					check_depend_cache *cache, int rownum,
+					depend_row *row);
+static inline void check_dependency_subid(pg_catalog_table *tab,
+					   pg_catalog_column *tabcol,
+					   check_depend_cache *cache, int rownum,
+					   depend_row *row);
+
+/*
+ * Kernels for a triple.  Only pg_shdepend contains rows for other databases,
+ * so the variant that skips those rows is used only there.
+ */
+#define DEFINE_DEPEND_KERNEL(name, skip_other_databases) \
+static void \
+name(check_step *step, pg_catalog_table *tab, int start, int end) \
+{ \
+	depend_triple *triple = step->state; \
+	check_depend_cache *cache = triple->cache; \
+	bool		need_object = (triple->object_col != NULL || \
+							   triple->subid_col != NULL); \
+	int			rownum; \
+\
+	for (rownum = start; rownum < end; ++rownum) \
+	{ \
+		depend_row	row; \
+\
+		if (skip_other_databases && \
+			not_for_this_database(cache->database_result_column, tab, \
+								  rownum)) \
+			continue; \
+\
+		row.class_valid = colstore_get_integer(tab->store, rownum, \
+											   cache->class_result_column, \
+											   false, &row.classid); \
+		row.object_tab = (row.class_valid && row.classid != 0) ? \
+			lookup_class_id(row.classid) : NULL; \
+		row.object_valid = need_object && \
+			colstore_get_integer(tab->store, rownum, \
+								 cache->object_result_column, false, \
+								 &row.objid); \
+		row.object_rownum = -2; \
+\
+		if (triple->class_col != NULL) \
+			check_dependency_class_id(tab, triple->class_col, cache, rownum, \
+									  &row); \
+		if (triple->object_col != NULL) \
+			check_dependency_id(tab, triple->object_col, cache, rownum, \
+								&row); \
+		if (triple->subid_col != NULL) \
+			check_dependency_subid(tab, triple->subid_col, cache, rownum, \
+								   &row); \
+	} \
+}
+
+DEFINE_DEPEND_KERNEL(check_triple_kernel, false)
+DEFINE_DEPEND_KERNEL(check_triple_kernel_shared, true)
+static void check_duplicate_owner_kernel(check_step *step,
+							 pg_catalog_table *tab, int start, int end);
+static void release_duplicate_owner_check(check_step *step);
+static bool owner_set_insert(duplicate_owner_cache *cache, uint32 *key);
+static void owner_set_grow(duplicate_owner_cache *cache);
+static uint32 owner_key_hash(uint32 *key);
+static void check_dependency_graph_kernel(check_step *step,
+							  pg_catalog_table *tab, int start, int end);
+static depgraph *build_dependency_graph(pg_catalog_table *tab);
+static bool object_is_missing(int classno, Oid objid);
 static depend_column_style get_style(char *table_name, char *column_name);
 static bool check_for_exception(char *table_name, char *classval,
 					char *objval);
@@ -147,6 +302,7 @@ prepare_to_check_dependency_class_id(pg_catalog_table *tab,
 	 * We need pg_class to figure out system catalog table OIDs.
 	 */
 	add_table_dependency(tab, pg_class);
+	pg_class->needs_rows = true;
 	pg_class_relname = find_column_by_name(pg_class, "relname");
 	pg_class_relname->needed = true;
 	pg_class_relnamespace = find_column_by_name(pg_class, "relnamespace");
@@ -185,23 +341,50 @@ prepare_to_check_dependency_id(pg_catalog_table *tab, pg_catalog_column *tabcol)
 			add_table_dependency(tab, cattab);
 
 	/* Force the necessary classid column to be selected. */
+	classid = find_dependency_class_column(tab, tabcol);
+	classid->needed = true;
+}
+
+/*
+ * Find the class ID column that goes with an object ID column.
+ */
+pg_catalog_column *
+find_dependency_class_column(pg_catalog_table *tab, pg_catalog_column *tabcol)
+{
 	switch (get_style(tab->table_name, tabcol->name))
 	{
 		case DEPEND_COLUMN_STYLE_OBJID:
 		case EDB_DDLTIME_COLUMN_STYLE_OBJID:
-			classid = find_column_by_name(tab, "classid");
-			break;
+			return find_column_by_name(tab, "classid");
 		case DEPEND_COLUMN_STYLE_REFOBJID:
-			classid = find_column_by_name(tab, "refclassid");
-			break;
+			return find_column_by_name(tab, "refclassid");
 		case DEPEND_COLUMN_STYLE_OBJOID:
-			classid = find_column_by_name(tab, "classoid");
-			break;
-		default:
-			pgcc_log(PGCC_FATAL, "unexpected depend column style");
-			return;			/* placate compiler */
+			return find_column_by_name(tab, "classoid");
 	}
-	classid->needed = true;
+
+	pgcc_log(PGCC_FATAL, "unexpected depend column style");
+	return NULL;				/* placate compiler */
+}
+
+/*
+ * Find the object ID column that goes with a sub-ID column.
+ */
+pg_catalog_column *
+find_dependency_object_column(pg_catalog_table *tab, pg_catalog_column *tabcol)
+{
+	switch (get_style(tab->table_name, tabcol->name))
+	{
+		case DEPEND_COLUMN_STYLE_OBJID:
+		case EDB_DDLTIME_COLUMN_STYLE_OBJID:
+			return find_column_by_name(tab, "objid");
+		case DEPEND_COLUMN_STYLE_REFOBJID:
+			return find_column_by_name(tab, "refobjid");
+		case DEPEND_COLUMN_STYLE_OBJOID:
+			return find_column_by_name(tab, "objoid");
+	}
+
+	pgcc_log(PGCC_FATAL, "unexpected depend column style");
+	return NULL;				/* placate compiler */
 }
 
 /*
@@ -211,9 +394,6 @@ void
 prepare_to_check_dependency_subid(pg_catalog_table *tab,
 								  pg_catalog_column *tabcol)
 {
-	pg_catalog_column *classid;
-	pg_catalog_column *objectid;
-
 	/*
 	 * Just as when checking a class ID, we need pg_class to map class IDs to
 	 * catalog tables.	Specifically, we've got to be able to identify the OID
@@ -227,29 +407,544 @@ prepare_to_check_dependency_subid(pg_catalog_table *tab,
 
 	/* We need the pg_attribute table to check sub-IDs. */
 	add_table_dependency(tab, find_table_by_name("pg_attribute"));
+	request_attribute_summary();
 
 	/* Make sure we have the class and object IDs. */
-	switch (get_style(tab->table_name, tabcol->name))
+	find_dependency_class_column(tab, tabcol)->needed = true;
+	find_dependency_object_column(tab, tabcol)->needed = true;
+}
+
+/*
+ * Compile a class ID check into a plan step.  Returns false if no new step is
+ * needed, either because the column can't be checked at all or because it
+ * has joined the step for the rest of its triple.
+ */
+bool
+bind_dependency_class_id_check(pg_catalog_table *tab,
+							   pg_catalog_column *tabcol, check_step *step)
+{
+	check_depend_cache *cache = build_depend_cache(tab, tabcol);
+
+	if (cache->is_broken)
+		return false;
+	return bind_depend_triple(tab, tabcol, step, cache, TRIPLE_CLASS_ID);
+}
+
+/*
+ * Compile an object ID check into a plan step, with the same return value as
+ * bind_dependency_class_id_check().
+ */
+bool
+bind_dependency_id_check(pg_catalog_table *tab, pg_catalog_column *tabcol,
+						 check_step *step)
+{
+	check_depend_cache *cache = build_depend_cache(tab, tabcol);
+
+	if (cache->is_broken)
+		return false;
+
+	/*
+	 * All the catalogs an object ID could refer to have been loaded by now,
+	 * so we can index them.
+	 */
+	if (!object_index_attempted)
+		build_object_index();
+	if (pg_type_table == NULL)
+		pg_type_table = find_table_by_name("pg_type");
+
+	return bind_depend_triple(tab, tabcol, step, cache, TRIPLE_OBJECT_ID);
+}
+
+/*
+ * Compile a sub-ID check into a plan step, with the same return value as
+ * bind_dependency_class_id_check().
+ */
+bool
+bind_dependency_subid_check(pg_catalog_table *tab, pg_catalog_column *tabcol,
+							check_step *step)
+{
+	check_depend_cache *cache = build_depend_cache(tab, tabcol);
+
+	if (cache->is_broken)
+		return false;
+	if (pg_attribute_table == NULL)
+		pg_attribute_table = find_table_by_name("pg_attribute");
+	if (pg_attribute_summary == NULL)
+		pg_attribute_summary = get_attribute_summary();
+
+	return bind_depend_triple(tab, tabcol, step, cache, TRIPLE_SUBID);
+}
+
+/*
+ * Add a column to the plan step for its triple.
+ *
+ * The columns of a triple are adjacent in the table's definition, so if the
+ * previous step of the plan checks another column of the same triple, this
+ * one joins it, and we return false since no new step is needed.  Since that
+ * step's reports are placed as though it were the triple's first column,
+ * they come out in the same order as if each column had a step of its own.
+ * Otherwise, we start a new step for the triple.
+ */
+static bool
+bind_depend_triple(pg_catalog_table *tab, pg_catalog_column *tabcol,
+				   check_step *step, check_depend_cache *cache,
+				   depend_triple_member member)
+{
+	depend_triple *triple = NULL;
+	pg_catalog_column **slot;
+	bool		new_step = false;
+
+	if (step > tab->plan &&
+		(step[-1].kernel == check_triple_kernel ||
+		 step[-1].kernel == check_triple_kernel_shared))
 	{
-		case DEPEND_COLUMN_STYLE_OBJID:
-		case EDB_DDLTIME_COLUMN_STYLE_OBJID:
-			classid = find_column_by_name(tab, "classid");
-			objectid = find_column_by_name(tab, "objid");
-			break;
-		case DEPEND_COLUMN_STYLE_REFOBJID:
-			classid = find_column_by_name(tab, "refclassid");
-			objectid = find_column_by_name(tab, "refobjid");
+		triple = step[-1].state;
+		if (triple->cache->class_result_column != cache->class_result_column)
+			triple = NULL;
+	}
+
+	if (triple == NULL)
+	{
+		triple = pg_malloc0(sizeof(depend_triple));
+		triple->cache = cache;
+		step->state = triple;
+		step->kernel = cache->database_result_column != -1 ?
+			check_triple_kernel_shared : check_triple_kernel;
+		new_step = true;
+	}
+
+	switch (member)
+	{
+		case TRIPLE_CLASS_ID:
+			slot = &triple->class_col;
 			break;
-		case DEPEND_COLUMN_STYLE_OBJOID:
-			classid = find_column_by_name(tab, "classoid");
-			objectid = find_column_by_name(tab, "objoid");
+		case TRIPLE_OBJECT_ID:
+			slot = &triple->object_col;
 			break;
 		default:
-			pgcc_log(PGCC_FATAL, "unexpected depend column style");
-			return;		/* placate compiler */
+			slot = &triple->subid_col;
+			break;
+	}
+	Assert(*slot == NULL);
+	*slot = tabcol;
+
+	return new_step;
+}
+
+/*
+ * Set up to check for objects with more than one owner.  This is a
+ * table-level check, since it looks at the database, class ID, object ID
+ * and dependency type of each row together.
+ */
+void
+prepare_to_check_duplicate_owner(pg_catalog_table *tab)
+{
+	find_column_by_name(tab, "dbid")->needed = true;
+	find_column_by_name(tab, "classid")->needed = true;
+	find_column_by_name(tab, "objid")->needed = true;
+	find_column_by_name(tab, "deptype")->needed = true;
+}
+
+/*
+ * Compile a duplicate owner check into a plan step.  Returns false if the
+ * columns it needs are missing.
+ */
+bool
+bind_duplicate_owner_check(pg_catalog_table *tab, check_step *step)
+{
+	duplicate_owner_cache *cache;
+
+	cache = pg_malloc(sizeof(duplicate_owner_cache));
+	cache->keycols[0] = colstore_fnumber(tab->store, "dbid");
+	cache->keycols[1] = colstore_fnumber(tab->store, "classid");
+	cache->keycols[2] = colstore_fnumber(tab->store, "objid");
+	cache->deptype_result_column = colstore_fnumber(tab->store, "deptype");
+	if (cache->keycols[0] == -1 || cache->keycols[1] == -1 ||
+		cache->keycols[2] == -1 || cache->deptype_result_column == -1)
+	{
+		pg_free(cache);
+		return false;
+	}
+
+	/*
+	 * Owner dependencies are a small fraction of the total.  If the table is
+	 * being streamed, we only see the first block here, and the set grows as
+	 * more keys arrive.
+	 */
+	cache->nentries = 0;
+	cache->size = 1024;
+	while (cache->size < (uint32) colstore_nrows(tab->store) / 4)
+		cache->size *= 2;
+	cache->entries = pg_malloc0(cache->size * sizeof(owner_entry));
+
+	step->state = cache;
+	step->kernel = check_duplicate_owner_kernel;
+	step->release = release_duplicate_owner_check;
+	return true;
+}
+
+/*
+ * Check for multiple owner dependencies for the same object.  Only rows for
+ * this database, or for global objects, are considered.
+ *
+ * Rows whose database OID, class ID or object ID isn't a valid OID are
+ * skipped, since the checks of those columns will complain about them
+ * anyway.
+ */
+static void
+check_duplicate_owner_kernel(check_step *step, pg_catalog_table *tab,
+							 int start, int end)
+{
+	duplicate_owner_cache *cache = step->state;
+	int			rownum;
+
+	for (rownum = start; rownum < end; ++rownum)
+	{
+		uint32		key[3];
+
+		if (strcmp(colstore_getvalue(tab->store, rownum,
+									 cache->deptype_result_column), "o") != 0)
+			continue;
+		if (not_for_this_database(cache->keycols[0], tab, rownum))
+			continue;
+		if (!colstore_get_integer(tab->store, rownum, cache->keycols[0],
+								  false, &key[0]) ||
+			!colstore_get_integer(tab->store, rownum, cache->keycols[1],
+								  false, &key[1]) ||
+			!colstore_get_integer(tab->store, rownum, cache->keycols[2],
+								  false, &key[2]))
+			continue;
+		if (!owner_set_insert(cache, key))
+			pgcc_report(tab, NULL, rownum, "duplicate owner dependency\n");
+	}
+}
+
+/*
+ * Free the set of owner dependencies once the table has been checked.
+ */
+static void
+release_duplicate_owner_check(check_step *step)
+{
+	duplicate_owner_cache *cache = step->state;
+
+	pgcc_log(PGCC_DEBUG,
+			 "freeing set of %u owner dependencies (%lu bytes)\n",
+			 cache->nentries,
+			 (unsigned long) (cache->size * sizeof(owner_entry)));
+	pg_free(cache->entries);
+	pg_free(cache);
+	step->state = NULL;
+}
+
+/*
+ * Add a key to the set of owner dependencies.  Returns false if it was
+ * already present.
+ */
+static bool
+owner_set_insert(duplicate_owner_cache *cache, uint32 *key)
+{
+	uint32		mask = cache->size - 1;
+	uint32		i = owner_key_hash(key) & mask;
+	owner_entry *entry;
+
+	while ((entry = &cache->entries[i])->used)
+	{
+		if (entry->key[0] == key[0] && entry->key[1] == key[1] &&
+			entry->key[2] == key[2])
+			return false;
+		i = (i + 1) & mask;
+	}
+
+	entry->key[0] = key[0];
+	entry->key[1] = key[1];
+	entry->key[2] = key[2];
+	entry->used = true;
+	if (++cache->nentries > cache->size / 2)
+		owner_set_grow(cache);
+
+	return true;
+}
+
+/*
+ * Double the number of slots in the set of owner dependencies.
+ */
+static void
+owner_set_grow(duplicate_owner_cache *cache)
+{
+	owner_entry *old = cache->entries;
+	uint32		old_size = cache->size;
+	uint32		mask;
+	uint32		i;
+
+	cache->size = old_size * 2;
+	cache->entries = pg_malloc0(cache->size * sizeof(owner_entry));
+	mask = cache->size - 1;
+	for (i = 0; i < old_size; i++)
+	{
+		uint32		j;
+
+		if (!old[i].used)
+			continue;
+		j = owner_key_hash(old[i].key) & mask;
+		while (cache->entries[j].used)
+			j = (j + 1) & mask;
+		cache->entries[j] = old[i];
+	}
+	pg_free(old);
+}
+
+/*
+ * Hash a packed owner key.  The class ID takes only a few distinct values
+ * and the database OID usually just one, so all the bits of each word must
+ * affect the result.
+ */
+static uint32
+owner_key_hash(uint32 *key)
+{
+	uint32		h;
+
+	h = key[0] * 0x9E3779B1U;
+	h = (h ^ key[1]) * 0x85EBCA77U;
+	h = (h ^ key[2]) * 0xC2B2AE3DU;
+	h ^= h >> 16;
+	h *= 0x7FEB352DU;
+	h ^= h >> 15;
+
+	return h;
+}
+
+/*
+ * Set up the checks of pg_depend as a whole graph.  Like an object ID check,
+ * these need pg_class to map class IDs to catalogs, and all the catalogs
+ * those could be, to find out which objects are missing.
+ */
+void
+prepare_to_check_dependency_graph(pg_catalog_table *tab)
+{
+	pg_catalog_table *pg_class = find_table_by_name("pg_class");
+	pg_catalog_table *cattab;
+
+	add_table_dependency(tab, pg_class);
+	pg_class->needs_rows = true;
+	find_column_by_name(pg_class, "relname")->needed = true;
+	find_column_by_name(pg_class, "relnamespace")->needed = true;
+
+	for (cattab = pg_catalog_tables; cattab->table_name != NULL; ++cattab)
+		if (table_key_is_oid(cattab))
+			add_table_dependency(tab, cattab);
+
+	find_column_by_name(tab, "classid")->needed = true;
+	find_column_by_name(tab, "objid")->needed = true;
+	find_column_by_name(tab, "refclassid")->needed = true;
+	find_column_by_name(tab, "refobjid")->needed = true;
+	find_column_by_name(tab, "deptype")->needed = true;
+
+	/* We need all the rows at once. */
+	tab->needs_all_rows = true;
+}
+
+/*
+ * Compile the graph checks of pg_depend into a plan step.
+ *
+ * All the work is done here: we load the dependencies into a graph, find
+ * the cycles and the broken chains of ownership, and flag the rows involved.
+ * The kernel then just reports the flagged rows as it comes to them.
+ */
+bool
+bind_dependency_graph_check(pg_catalog_table *tab, check_step *step)
+{
+	dependency_graph_cache *cache;
+	depgraph   *graph;
+	int		   *component;
+	int		   *component_size;
+	bool	   *missing;
+	bool	   *owner_missing;
+	int			nnodes;
+	int			node;
+
+	if (!class_id_mappings_attempted)
+		build_class_id_mappings();
+	if (class_id_mapping == NULL)
+		return false;
+	if (!object_index_attempted)
+		build_object_index();
+
+	graph = build_dependency_graph(tab);
+	if (graph == NULL)
+		return false;
+	nnodes = depgraph_nnodes(graph);
+
+	cache = pg_malloc(sizeof(dependency_graph_cache));
+	cache->row_flags = pg_malloc0(Max(colstore_nrows(tab->store), 1));
+
+	/* Find the objects that don't exist. */
+	missing = pg_malloc(Max(nnodes, 1) * sizeof(bool));
+	for (node = 0; node < nnodes; ++node)
+	{
+		int			classno;
+		Oid			objid;
+
+		depgraph_node_address(graph, node, &classno, &objid);
+		missing[node] = object_is_missing(classno, objid);
+	}
+
+	component = depgraph_components(graph, GRAPH_CYCLE_DEPTYPES,
+									&component_size);
+	owner_missing = depgraph_reaching(graph, GRAPH_OWNER_DEPTYPES, missing);
+
+	/*
+	 * Flag each dependency that joins two objects of the same cycle, and
+	 * each ownership dependency on an object that exists but whose own
+	 * owners, followed far enough, don't.  A dependency on an object that
+	 * doesn't exist at all is already reported by the object ID check.
+	 */
+	for (node = 0; node < nnodes; ++node)
+	{
+		int		   *target;
+		char	   *label;
+		int		   *id;
+		int			nedges;
+		int			i;
+
+		nedges = depgraph_edges(graph, node, &target, &label, &id);
+		for (i = 0; i < nedges; ++i)
+		{
+			if (strchr(GRAPH_CYCLE_DEPTYPES, label[i]) != NULL &&
+				component[target[i]] == component[node] &&
+				component_size[component[node]] > 1)
+				cache->row_flags[id[i]] |= GRAPH_ROW_IN_CYCLE;
+			if (strchr(GRAPH_OWNER_DEPTYPES, label[i]) != NULL &&
+				!missing[target[i]] && owner_missing[target[i]])
+				cache->row_flags[id[i]] |= GRAPH_ROW_OWNER_MISSING;
+		}
+	}
+
+	pgcc_log(PGCC_DEBUG,
+			 "checked %d objects of dependency graph for %s in %lu bytes\n",
+			 nnodes, tab->table_name,
+			 (unsigned long) depgraph_memory(graph));
+
+	pg_free(missing);
+	pg_free(owner_missing);
+	pg_free(component);
+	pg_free(component_size);
+	depgraph_destroy(graph);
+
+	step->state = cache;
+	step->kernel = check_dependency_graph_kernel;
+	return true;
+}
+
+/*
+ * Report the rows flagged by the graph checks.
+ */
+static void
+check_dependency_graph_kernel(check_step *step, pg_catalog_table *tab,
+							  int start, int end)
+{
+	dependency_graph_cache *cache = step->state;
+	int			rownum;
+
+	for (rownum = start; rownum < end; ++rownum)
+	{
+		if (cache->row_flags[rownum] & GRAPH_ROW_IN_CYCLE)
+			pgcc_report(tab, NULL, rownum,
+						"dependency is part of a cycle\n");
+		if (cache->row_flags[rownum] & GRAPH_ROW_OWNER_MISSING)
+			pgcc_report(tab, NULL, rownum,
+						"referenced object is owned, directly or indirectly, by a missing object\n");
 	}
-	classid->needed = true;
-	objectid->needed = true;
+}
+
+/*
+ * Load the dependencies recorded in a table into a graph, with each object
+ * identified by the catalog its class ID maps to and its object ID.
+ *
+ * Pin dependencies, dependencies between parts of the same object, and
+ * rows that the class ID and object ID checks will complain about are left
+ * out.  So are normal dependencies between types and functions: a base type
+ * depends on its input and output functions, which depend on it in turn as
+ * their argument or result type, so every user-defined base type is part of
+ * such a cycle.  pg_dump has to break the same loops (see repairTypeFuncLoop).
+ */
+static depgraph *
+build_dependency_graph(pg_catalog_table *tab)
+{
+	int			classid_column = colstore_fnumber(tab->store, "classid");
+	int			objid_column = colstore_fnumber(tab->store, "objid");
+	int			refclassid_column = colstore_fnumber(tab->store, "refclassid");
+	int			refobjid_column = colstore_fnumber(tab->store, "refobjid");
+	int			deptype_column = colstore_fnumber(tab->store, "deptype");
+	int			ntups = colstore_nrows(tab->store);
+	pg_catalog_table *pg_type = find_table_by_name("pg_type");
+	pg_catalog_table *pg_proc = find_table_by_name("pg_proc");
+	depgraph   *graph;
+	int			rownum;
+
+	if (classid_column == -1 || objid_column == -1 ||
+		refclassid_column == -1 || refobjid_column == -1 ||
+		deptype_column == -1)
+		return NULL;
+
+	graph = depgraph_create(ntups);
+	for (rownum = 0; rownum < ntups; ++rownum)
+	{
+		uint32		classid;
+		uint32		objid;
+		uint32		refclassid;
+		uint32		refobjid;
+		pg_catalog_table *object_tab;
+		pg_catalog_table *refobject_tab;
+		char	   *deptype;
+
+		deptype = colstore_getvalue(tab->store, rownum, deptype_column);
+		if (deptype[0] == '\0' || deptype[1] != '\0' || deptype[0] == 'p')
+			continue;
+
+		if (!colstore_get_integer(tab->store, rownum, classid_column, false,
+								  &classid) ||
+			!colstore_get_integer(tab->store, rownum, objid_column, false,
+								  &objid) ||
+			!colstore_get_integer(tab->store, rownum, refclassid_column,
+								  false, &refclassid) ||
+			!colstore_get_integer(tab->store, rownum, refobjid_column,
+								  false, &refobjid))
+			continue;
+		if (classid == refclassid && objid == refobjid)
+			continue;
+
+		object_tab = lookup_class_id(classid);
+		refobject_tab = lookup_class_id(refclassid);
+		if (object_tab == NULL || refobject_tab == NULL)
+			continue;
+		if (deptype[0] == 'n' &&
+			((object_tab == pg_type && refobject_tab == pg_proc) ||
+			 (object_tab == pg_proc && refobject_tab == pg_type)))
+			continue;
+
+		depgraph_add_edge(graph, object_tab - pg_catalog_tables, objid,
+						  refobject_tab - pg_catalog_tables, refobjid,
+						  deptype[0], rownum);
+	}
+	depgraph_finish(graph);
+
+	return graph;
+}
+
+/*
+ * Is the object with this address known not to exist?  We can't tell if we
+ * failed to load the catalog that should contain it.
+ */
+static bool
+object_is_missing(int classno, Oid objid)
+{
+	pg_catalog_table *object_tab = &pg_catalog_tables[classno];
+
+	if (object_tab->oids != NULL)
+		return !oidset_contains(object_tab->oids, objid);
+	if (object_tab->ht == NULL || object_index == NULL)
+		return false;
+	return objaddr_index_get(object_index, classno, objid) == -1;
 }
 
 /*
@@ -259,26 +954,16 @@ prepare_to_check_dependency_subid(pg_catalog_table *tab,
  * table that we know about and that's supposed to exists in this server
  * version, or else 0 if that's a legal value in this context.
  */
-void
+static inline void
 check_dependency_class_id(pg_catalog_table *tab, pg_catalog_column *tabcol,
-						  int rownum)
+						  check_depend_cache *cache, int rownum,
+						  depend_row *row)
 {
-	char	   *val;
-	check_depend_cache *cache;
-
-	cache = build_depend_cache(tab, tabcol);
-	if (cache->is_broken)
-		return;
-	if (not_for_this_database(cache, tab, tabcol, rownum))
-		return;
-
-	val = PQgetvalue(tab->data, rownum, tabcol->result_column);
-
 	/*
 	 * We normally expect that the class ID is non-zero, but "pin" depedencies
 	 * are an exception.
 	 */
-	if (strcmp(val, "0") == 0)
+	if (row->class_valid && row->classid == 0)
 	{
 		bool		complain = true;
 
@@ -286,8 +971,8 @@ check_dependency_class_id(pg_catalog_table *tab, pg_catalog_column *tabcol,
 		{
 			char	   *deptype;
 
-			deptype = PQgetvalue(tab->data, rownum,
-								 cache->deptype_result_column);
+			deptype = colstore_getvalue(tab->store, rownum,
+										cache->deptype_result_column);
 
 			if (strcmp(deptype, "p") == 0)
 				complain = false;
@@ -298,14 +983,14 @@ check_dependency_class_id(pg_catalog_table *tab, pg_catalog_column *tabcol,
 		return;
 	}
 
-	if (lookup_class_id(val) == NULL)
+	if (row->object_tab == NULL)
 	{
 		/*
 		 * Workaround for an old EnterpriseDB bug: 8.4 installed a bogus
 		 * dependency with reclassid 16722.
 		 */
 		if (remote_is_edb && remote_version <= 90000 &&
-			strcmp(val, "16722") == 0)
+			row->class_valid && row->classid == 16722)
 		{
 			pgcc_log(PGCC_DEBUG, "ignoring reference to class ID 16722\n");
 			return;
@@ -321,50 +1006,34 @@ check_dependency_class_id(pg_catalog_table *tab, pg_catalog_column *tabcol,
  * contain the indicated object.  We then look up that table and check
  * whether the value appears in its OID column.
  */
-void
+static inline void
 check_dependency_id(pg_catalog_table *tab, pg_catalog_column *tabcol,
-					int rownum)
+					check_depend_cache *cache, int rownum, depend_row *row)
 {
-	char	   *classval;
-	char	   *val;
-	pg_catalog_table *object_tab;
-	check_depend_cache *cache;
-
-	cache = build_depend_cache(tab, tabcol);
-	if (cache->is_broken)
-		return;
-	if (not_for_this_database(cache, tab, tabcol, rownum))
-		return;
+	uint32		objid = row->objid;
+	bool		objid_valid = row->object_valid;
+	pg_catalog_table *object_tab = row->object_tab;
+	bool		found;
 
 	/*
-	 * Check for multiple owner dependencies for the same object.
-	 *
-	 * FIXME: Current pg_catcheck design don't support table-level checks,
-	 * all checks are column-level. We might want to re-architect this at
-	 * some point in the future.  For now, we check this here.
+	 * A class ID that isn't a well-formed OID can't identify a table, and is
+	 * complained about elsewhere.
 	 */
-	if (cache->duplicate_owner_ht != NULL &&
-		strcmp(PQgetvalue(tab->data, rownum,
-						  PQfnumber(tab->data, "deptype")), "o") == 0 &&
-		pgrhash_insert(cache->duplicate_owner_ht, rownum) != -1)
-		pgcc_report(tab, NULL, rownum, "duplicate owner dependency\n");
-
-	/* Fetch the class ID and object ID. */
-	classval = PQgetvalue(tab->data, rownum, cache->class_result_column);
-	val = PQgetvalue(tab->data, rownum, tabcol->result_column);
+	if (!row->class_valid)
+		return;
 
 	/* If the class ID is zero, the object ID should be zero as well. */
-	if (strcmp(classval, "0") == 0)
+	if (row->classid == 0)
 	{
-		if (strcmp(val, "0") != 0)
+		if (!objid_valid || objid != 0)
 			pgcc_report(tab, tabcol, rownum,
 						"class ID is zero, but object ID is non-zero\n");
 		return;
 	}
 
-	/* Find the correct table. */
-	object_tab = lookup_class_id(classval);
-	if (object_tab == NULL || object_tab->ht == NULL)
+	/* Check that we found the correct table. */
+	if (object_tab == NULL ||
+		(object_tab->ht == NULL && object_tab->oids == NULL))
 		return;
 
 	/*
@@ -373,10 +1042,8 @@ check_dependency_id(pg_catalog_table *tab, pg_catalog_column *tabcol,
 	 * never create a real type with that OID, this was (as far as we know)
 	 * harmless, so just ignore them.
 	 */
-	if (pg_type_table == NULL)
-		pg_type_table = find_table_by_name("pg_type");
 	if (remote_version < 90400 && remote_is_edb && object_tab == pg_type_table
-		&& strcmp(val, "0") == 0)
+		&& objid_valid && objid == 0)
 	{
 		pgcc_log(PGCC_DEBUG,
 				 "ignoring reference to pg_type OID 0\n");
@@ -384,11 +1051,35 @@ check_dependency_id(pg_catalog_table *tab, pg_catalog_column *tabcol,
 	}
 
 	/*
-	 * lookup_class_id() will only return tables where the only key column is
-	 * the OID column.	So this is safe.
+	 * Every table that lookup_class_id() can return is keyed only by OID and
+	 * has been loaded by now, so it's either in the object index or has been
+	 * reduced to a set of OIDs.  A value that isn't a well-formed OID can't
+	 * be in either, but we still look for it in the table's own hash, if
+	 * any, so as to behave exactly as a string match.
 	 */
-	if (pgrhash_get(object_tab->ht, &val) == -1 &&
-		!check_for_exception(tab->table_name, classval, val))
+	if (!objid_valid)
+	{
+		char	   *val = colstore_getvalue(tab->store, rownum,
+											tabcol->result_column);
+
+		found = object_tab->ht != NULL &&
+			pgrhash_get(object_tab->ht, &val) != -1;
+	}
+	else if (object_tab->oids != NULL)
+		found = oidset_contains(object_tab->oids, objid);
+	else
+	{
+		row->object_rownum = object_index == NULL ? -1 :
+			objaddr_index_get(object_index, object_tab - pg_catalog_tables,
+							  objid);
+		found = row->object_rownum != -1;
+	}
+	if (!found &&
+		!check_for_exception(tab->table_name,
+							 colstore_getvalue(tab->store, rownum,
+											   cache->class_result_column),
+							 colstore_getvalue(tab->store, rownum,
+											   tabcol->result_column)))
 		pgcc_report(tab, tabcol, rownum, "no matching entry in %s\n",
 					object_tab->table_name);
 }
@@ -400,34 +1091,18 @@ check_dependency_id(pg_catalog_table *tab, pg_catalog_column *tabcol,
  * pg_class.  In that case, should be able to find <object ID, sub-ID> in
  * pg_attribute. The object ID will appear in attrelid and the sub-ID in attnum.
  */
-void
+static inline void
 check_dependency_subid(pg_catalog_table *tab, pg_catalog_column *tabcol,
-					   int rownum)
+					   check_depend_cache *cache, int rownum, depend_row *row)
 {
-	char	   *classval;
-	char	   *vals[2];
-	check_depend_cache *cache;
-
-	cache = build_depend_cache(tab, tabcol);
-	if (cache->is_broken)
-		return;
-	if (not_for_this_database(cache, tab, tabcol, rownum))
-		return;
-
-	/*
-	 * We find pg_attribute on our first trip through this function and avoid
-	 * repeating the lookup thereafter using a global variable.
-	 */
-	if (pg_attribute_table == NULL)
-		pg_attribute_table = find_table_by_name("pg_attribute");
-
-	/* Fetch the class ID, object ID, and sub-ID. */
-	classval = PQgetvalue(tab->data, rownum, cache->class_result_column);
-	vals[0] = PQgetvalue(tab->data, rownum, cache->object_result_column);
-	vals[1] = PQgetvalue(tab->data, rownum, tabcol->result_column);
+	uint32		key[2];
+	bool		subid_valid;
+	enum trivalue present = TRI_DEFAULT;
 
 	/* Sub-ID is always permitted to be zero. */
-	if (strcmp(vals[1], "0") == 0)
+	subid_valid = colstore_get_integer(tab->store, rownum,
+									   tabcol->result_column, true, &key[1]);
+	if (subid_valid && key[1] == 0)
 		return;
 
 	/*
@@ -436,46 +1111,92 @@ check_dependency_subid(pg_catalog_table *tab, pg_catalog_column *tabcol,
 	 * If it does point to pg_class, then a matching pg_attribute row should
 	 * exist.
 	 */
-	if (strcmp(classval, pg_class_oid) != 0)
+	if (!row->class_valid || row->classid != pg_class_oid)
 		pgcc_report(tab, tabcol, rownum,
 					"class ID %s is not pg_class, but sub-ID is non-zero\n",
-					classval);
+					colstore_getvalue(tab->store, rownum,
+									  cache->class_result_column));
 	else if (pg_attribute_table->ht)	/* We might have failed to read it. */
 	{
-		if (pgrhash_get(pg_attribute_table->ht, vals) == -1)
+		/*
+		 * If we can find the relation's pg_class row, which the object ID
+		 * check has usually done already, the attribute summary can most
+		 * likely tell us whether the attribute exists.
+		 */
+		if (subid_valid && row->object_valid &&
+			pg_attribute_summary != NULL && row->object_tab != NULL)
+		{
+			if (row->object_rownum == -2)
+				row->object_rownum = object_index == NULL ? -1 :
+					objaddr_index_get(object_index,
+									  row->object_tab - pg_catalog_tables,
+									  row->objid);
+			if (row->object_rownum >= 0)
+				present = attribute_summary_contains(pg_attribute_summary,
+													 row->object_rownum,
+													 (int32) key[1]);
+		}
+
+		/* If not, look up <object ID, sub-ID>, as integers if we can. */
+		if (present == TRI_DEFAULT)
+		{
+			int			attrow;
+
+			if (subid_valid && row->object_valid)
+			{
+				key[0] = row->objid;
+				attrow = pgrhash_get_integer(pg_attribute_table->ht, key);
+			}
+			else
+			{
+				char	   *vals[2];
+
+				vals[0] = colstore_getvalue(tab->store, rownum,
+											cache->object_result_column);
+				vals[1] = colstore_getvalue(tab->store, rownum,
+											tabcol->result_column);
+				attrow = pgrhash_get(pg_attribute_table->ht, vals);
+			}
+			present = attrow == -1 ? TRI_NO : TRI_YES;
+		}
+		if (present == TRI_NO)
 			pgcc_report(tab, tabcol, rownum, "no matching entry in %s\n",
 						pg_attribute_table->table_name);
 	}
 }
 
 /*
- * Given a text-form OID found in an objid or refobjid table, search for a
+ * Given a class ID found in an objid or refobjid table, search for a
  * corresponding catalog table.
- *
- * NB: We could make this more efficient by teaching build_class_id_mappings()
- * to sort the array, and then using binary search.
  */
 static pg_catalog_table *
-lookup_class_id(char *oid)
+lookup_class_id(Oid oid)
 {
 	int			i;
 
 	Assert(class_id_mappings_attempted && class_id_mapping != NULL);
 
 	/* For LargeObjectRelationId, substitute LargeObjectMetadataOidIndexId. */
-	if (strcmp(oid, "2613") == 0)
-		oid = "2995";
+	if (oid == 2613)
+		oid = 2995;
 
+	if (oid < CLASS_ID_DIRECT_LIMIT)
+	{
+		i = class_id_direct[oid];
+		return i == -1 ? NULL : class_id_mapping[i].tab;
+	}
+
+	/* Not expected, but pg_class could say otherwise. */
 	for (i = 0; i < num_class_id_mapping; ++i)
-		if (strcmp(class_id_mapping[i].oid, oid) == 0)
+		if (class_id_mapping[i].oid == oid)
 			return class_id_mapping[i].tab;
 
 	return NULL;
 }
 
 /*
- * Build a set of mappings from text-form OIDs which PQgetvalue might hand
- * back for an objid or refobjid column to pg_catalog_table objects.
+ * Build a set of mappings from the class IDs which might appear in an objid
+ * or refobjid table to pg_catalog_table objects.
  */
 static void
 build_class_id_mappings(void)
@@ -483,6 +1204,7 @@ build_class_id_mappings(void)
 	int			map_used = 0;
 	int			map_size = 10;
 	class_id_mapping_type *map;
+	int16	   *direct;
 	pg_catalog_table *pg_class_tab;
 	int			oid_column;
 	int			relnamespace_column;
@@ -499,8 +1221,8 @@ build_class_id_mappings(void)
 
 	/* Find the pg_class table. */
 	pg_class_tab = find_table_by_name("pg_class");
-	if (pg_class_tab->data != NULL)
-		ntups = PQntuples(pg_class_tab->data);
+	if (pg_class_tab->store != NULL)
+		ntups = colstore_nrows(pg_class_tab->store);
 	if (ntups == 0)
 	{
 		pgcc_log(PGCC_WARNING,
@@ -509,9 +1231,9 @@ build_class_id_mappings(void)
 	}
 
 	/* Find the pg_class columns we need. */
-	oid_column = PQfnumber(pg_class_tab->data, "oid");
-	relnamespace_column = PQfnumber(pg_class_tab->data, "relnamespace");
-	relname_column = PQfnumber(pg_class_tab->data, "relname");
+	oid_column = colstore_fnumber(pg_class_tab->store, "oid");
+	relnamespace_column = colstore_fnumber(pg_class_tab->store, "relnamespace");
+	relname_column = colstore_fnumber(pg_class_tab->store, "relname");
 	if (oid_column == -1 || relname_column == -1 || relnamespace_column == -1)
 	{
 		pgcc_log(PGCC_WARNING,
@@ -526,16 +1248,18 @@ build_class_id_mappings(void)
 	for (i = 0; i < ntups; ++i)
 	{
 		pg_catalog_table *tab;
-		char	   *relnamespace;
+		uint32		relnamespace;
 		char	   *relname;
+		uint32		oid;
 
 		/* Skip tables that are not part of the pg_catalog namespace. */
-		relnamespace = PQgetvalue(pg_class_tab->data, i, relnamespace_column);
-		if (strcmp(relnamespace, "11") != 0)
+		if (!colstore_get_integer(pg_class_tab->store, i, relnamespace_column,
+								  false, &relnamespace) ||
+			relnamespace != 11)
 			continue;
 
 		/* See if it's a catalog table we know about. */
-		relname = PQgetvalue(pg_class_tab->data, i, relname_column);
+		relname = colstore_getvalue(pg_class_tab->store, i, relname_column);
 		for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
 		{
 			/* Skip table if name does not match. */
@@ -550,6 +1274,11 @@ build_class_id_mappings(void)
 			if (!table_key_is_oid(tab))
 				break;
 
+			/* Ignore matching table if its OID is garbled. */
+			if (!colstore_get_integer(pg_class_tab->store, i, oid_column,
+									  false, &oid))
+				break;
+
 			/* Increase map space if required. */
 			if (map_used >= map_size)
 			{
@@ -559,7 +1288,7 @@ build_class_id_mappings(void)
 			}
 
 			/* Create map entry. */
-			map[map_used].oid = PQgetvalue(pg_class_tab->data, i, oid_column);
+			map[map_used].oid = oid;
 			map[map_used].tab = tab;
 
 			/*
@@ -567,7 +1296,7 @@ build_class_id_mappings(void)
 			 * checking sub-IDs.
 			 */
 			if (pg_class_tab == tab)
-				pg_class_oid = map[map_used].oid;
+				pg_class_oid = oid;
 
 			++map_used;
 			break;
@@ -589,18 +1318,99 @@ build_class_id_mappings(void)
 	 * truly makes it necessary is that sub-ID verification needs
 	 * pg_class_oid.
 	 */
-	if (pg_class_oid == NULL)
+	if (!OidIsValid(pg_class_oid))
 	{
 		pgcc_log(PGCC_WARNING,
 			   "can't identify class IDs: pg_class not found in pg_class\n");
 		return;
 	}
 
+	/*
+	 * Index the mapping by OID.  If pg_class lists the same OID more than
+	 * once, the first entry wins, as it would in a search of the array.
+	 */
+	direct = pg_malloc(CLASS_ID_DIRECT_LIMIT * sizeof(int16));
+	memset(direct, -1, CLASS_ID_DIRECT_LIMIT * sizeof(int16));
+	for (i = 0; i < map_used; ++i)
+		if (map[i].oid < CLASS_ID_DIRECT_LIMIT && direct[map[i].oid] == -1)
+			direct[map[i].oid] = i;
+
 	/* Install new mapping table. */
 	class_id_mapping = map;
+	class_id_direct = direct;
 	num_class_id_mapping = map_used;
 }
 
+/*
+ * Build an index of every object in the catalogs to which the class ID
+ * mappings refer, keyed by the catalog's position in pg_catalog_tables and
+ * the object's OID.
+ *
+ * This must not be called until an object ID check is compiled, because
+ * only then is it certain that all of those catalogs have been loaded.
+ */
+static void
+build_object_index(void)
+{
+	int			nobjects = 0;
+	int			i;
+
+	object_index_attempted = true;
+	if (class_id_mapping == NULL)
+		return;
+
+	for (i = 0; i < num_class_id_mapping; ++i)
+	{
+		pg_catalog_table *tab = class_id_mapping[i].tab;
+
+		if (tab->ht != NULL)
+			nobjects += colstore_nrows(tab->store);
+	}
+
+	object_index = objaddr_index_create(nobjects);
+
+	for (i = 0; i < num_class_id_mapping; ++i)
+	{
+		pg_catalog_table *tab = class_id_mapping[i].tab;
+		int			oid_column;
+		int			ntups;
+		int			rownum;
+
+		/*
+		 * Skip tables we failed to load, and tables already reduced to OID
+		 * sets.  If pg_class lists a table more than once, we index it more
+		 * than once, but that's harmless.
+		 */
+		if (tab->ht == NULL)
+			continue;
+
+		oid_column = colstore_fnumber(tab->store, "oid");
+		if (oid_column == -1)
+			continue;
+
+		ntups = colstore_nrows(tab->store);
+		for (rownum = 0; rownum < ntups; ++rownum)
+		{
+			uint32		objid;
+
+			if (colstore_get_integer(tab->store, rownum, oid_column, false,
+									 &objid))
+				objaddr_index_insert(object_index, tab - pg_catalog_tables,
+									 objid, rownum);
+		}
+	}
+}
+
+/*
+ * Report statistics for the object index, if debugging output is enabled.
+ */
+void
+report_dependency_stats(void)
+{
+	if (object_index != NULL)
+		objaddr_index_report_stats(object_index);
+}
+
 /*
  * Is oid the only key column for this table?
  */
@@ -626,7 +1436,7 @@ table_key_is_oid(pg_catalog_table *tab)
 
 /*
  * Cache per-column dependency checking information, basically column indexes
- * into the PGresult structure so that we can quickly find the class ID for
+ * into the table's column store so that we can quickly find the class ID for
  * an object ID and the class and object ID for a sub-ID.
  */
 static check_depend_cache *
@@ -647,31 +1457,31 @@ build_depend_cache(pg_catalog_table *tab, pg_catalog_column *tabcol)
 	{
 		case DEPEND_COLUMN_STYLE_OBJID:
 			/* special case for pg_shdepend */
-			cache->database_result_column = PQfnumber(tab->data, "dbid");
-			cache->class_result_column = PQfnumber(tab->data, "classid");
-			cache->object_result_column = PQfnumber(tab->data, "objid");
+			cache->database_result_column = colstore_fnumber(tab->store, "dbid");
+			cache->class_result_column = colstore_fnumber(tab->store, "classid");
+			cache->object_result_column = colstore_fnumber(tab->store, "objid");
 			break;
 		case EDB_DDLTIME_COLUMN_STYLE_OBJID:
 			cache->database_result_column = -1;
-			cache->class_result_column = PQfnumber(tab->data, "classid");
-			cache->object_result_column = PQfnumber(tab->data, "objid");
+			cache->class_result_column = colstore_fnumber(tab->store, "classid");
+			cache->object_result_column = colstore_fnumber(tab->store, "objid");
 			break;
 		case DEPEND_COLUMN_STYLE_REFOBJID:
 			cache->database_result_column = -1;
-			cache->class_result_column = PQfnumber(tab->data, "refclassid");
-			cache->object_result_column = PQfnumber(tab->data, "refobjid");
+			cache->class_result_column = colstore_fnumber(tab->store, "refclassid");
+			cache->object_result_column = colstore_fnumber(tab->store, "refobjid");
 			break;
 		case DEPEND_COLUMN_STYLE_OBJOID:
 			cache->database_result_column = -1;
-			cache->class_result_column = PQfnumber(tab->data, "classoid");
-			cache->object_result_column = PQfnumber(tab->data, "objoid");
+			cache->class_result_column = colstore_fnumber(tab->store, "classoid");
+			cache->object_result_column = colstore_fnumber(tab->store, "objoid");
 			break;
 		default:
 			pgcc_log(PGCC_FATAL, "unexpected depend column style");
 			break;
 	}
 
-	/* Verify that PQfnumber() worked as expected. */
+	/* Verify that colstore_fnumber() worked as expected. */
 	if (cache->class_result_column == -1)
 		columns_missing = true;
 	if (cache->object_result_column == -1)
@@ -680,7 +1490,7 @@ build_depend_cache(pg_catalog_table *tab, pg_catalog_column *tabcol)
 	/* Look up the column number for the deptype column, if expected. */
 	if (cache->style == DEPEND_COLUMN_STYLE_OBJID)
 	{
-		cache->deptype_result_column = PQfnumber(tab->data, "deptype");
+		cache->deptype_result_column = colstore_fnumber(tab->store, "deptype");
 		if (cache->deptype_result_column == -1)
 			columns_missing = true;
 	}
@@ -715,20 +1525,6 @@ build_depend_cache(pg_catalog_table *tab, pg_catalog_column *tabcol)
 	if (class_id_mapping == NULL)
 		cache->is_broken = true;
 
-	/*
-	 * If needed, create hash table for duplicate-owner-dependency cheecking.
-	 */
-	if (!cache->is_broken && cache->database_result_column != -1 &&
-		cache->deptype_result_column != -1)
-	{
-		int					keycols[3];
-
-		keycols[0] = cache->database_result_column;
-		keycols[1] = cache->class_result_column;
-		keycols[2] = cache->object_result_column;
-		cache->duplicate_owner_ht = pgrhash_create(tab->data, 3, keycols);
-	}
-
 	/* We're done. */
 	tabcol->check_private = cache;
 	return cache;
@@ -740,20 +1536,19 @@ build_depend_cache(pg_catalog_table *tab, pg_catalog_column *tabcol)
  * a table that has a dbid column, which currently means just pg_shdepend.
  */
 static bool
-not_for_this_database(check_depend_cache *cache, pg_catalog_table *tab,
-					  pg_catalog_column *tabcol, int rownum)
+not_for_this_database(int database_result_column, pg_catalog_table *tab,
+					  int rownum)
 {
-	char	   *dbval;
+	uint32		dbid;
 
 	/* If there's no dbid column, then it's part of this database. */
-	if (cache->database_result_column == -1)
+	if (database_result_column == -1)
 		return false;
 
-	/* Look up the value in that column. */
-	dbval = PQgetvalue(tab->data, rownum, cache->database_result_column);
-
 	/* 0 means it's a global object, so it's fine to check it here. */
-	if (strcmp(dbval, "0") == 0)
+	if (colstore_get_integer(tab->store, rownum, database_result_column,
+							 false, &dbid) &&
+		dbid == 0)
 		return false;
 
 	/*
@@ -764,7 +1559,9 @@ not_for_this_database(check_depend_cache *cache, pg_catalog_table *tab,
 		return true;
 
 	/* Straightforward comparison. */
-	return strcmp(database_oid, dbval) != 0;
+	return strcmp(database_oid,
+				  colstore_getvalue(tab->store, rownum,
+									database_result_column)) != 0;
 }
 
 /*
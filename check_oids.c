@@ -14,9 +14,134 @@
 #include "postgres_fe.h"
 #include "pg_catcheck.h"
 
-static void do_oid_check(pg_catalog_table *tab, pg_catalog_column *tabcol,
-			 int rownum, pg_catalog_check_oid * check_oid,
-			 pg_catalog_table *reftab, char *value);
+/*
+ * Columns such as relnamespace, relowner and atttypid contain the same few
+ * values over and over again, so we remember the outcome of recent lookups
+ * in a small direct-mapped cache and skip the hash probe when the same value
+ * comes around again.
+ */
+#define OID_MEMO_BITS		6
+#define OID_MEMO_SIZE		(1 << OID_MEMO_BITS)
+
+typedef struct oid_memo_entry
+{
+	uint32		oid;
+	bool		valid;			/* is this entry in use? */
+	bool		found;			/* was oid found in the referenced table? */
+} oid_memo_entry;
+
+/*
+ * Simple references are normally checked by probing the referenced table's
+ * hash table, but when both tables are large, random probes into the hash
+ * mostly miss the CPU cache.  In that case we instead sort the referenced
+ * table's OIDs once, sort each block of referencing values, and walk the
+ * two in step, as in a merge join.  We only do this when the sorted array
+ * fits within MERGE_MEMORY_BUDGET.
+ */
+#define MERGE_MIN_ROWS			65536
+#define MERGE_MEMORY_BUDGET		((Size) 64 * 1024 * 1024)
+
+/*
+ * The elements of an OID vector or array are collected for a whole row
+ * before any are looked up.  Elements that aren't the last in a vector are
+ * limited to this length, as a sanity check.
+ */
+#define OID_TOKEN_MAX		32
+
+typedef struct oid_token
+{
+	const char *start;			/* element text, within the column value */
+	size_t		len;			/* ... and its length */
+	bool		valid;			/* is it a well-formed OID? */
+	uint32		oid;			/* if so, its value */
+	bool		found;			/* was it found in the referenced table? */
+} oid_token;
+
+typedef struct check_oid_cache
+{
+	pg_catalog_table *reftab;
+	uint64		lookups;		/* values looked up for this column */
+	uint64		memo_hits;		/* ... answered from the memo */
+	oid_memo_entry memo[OID_MEMO_SIZE];
+	int			ntokens;		/* elements collected from current row */
+	int			ntokens_allocated;
+	oid_token  *tokens;
+	bool		join;			/* checked against a join index? */
+	int		   *join_index;		/* if so, the referenced rows */
+	bool		merge;			/* checked by merging, not hash probes? */
+	int			nmerge_allocated;
+	uint32	   *merge_oids;		/* values from current block */
+	int		   *merge_rows;		/* ... and the rows they came from */
+} check_oid_cache;
+
+static bool lookup_oid(check_oid_cache *cache, char *value);
+static bool lookup_oid_value(check_oid_cache *cache, uint32 oid);
+static bool choose_merge(pg_catalog_table *tab, pg_catalog_table *reftab);
+static void check_oid_block_by_merge(check_step *step, pg_catalog_table *tab,
+						 int start, int end, bool zero_oid_ok);
+static void check_oid_block_by_join(check_step *step, pg_catalog_table *tab,
+						int start, int end, bool zero_oid_ok);
+static int	gallop_to(const uint32 *oids, int noids, int pos, uint32 oid);
+static inline void check_one_oid(pg_catalog_table *tab,
+			  pg_catalog_column *tabcol, int rownum,
+			  check_oid_cache *cache, bool zero_oid_ok);
+static inline void check_oid_vector(pg_catalog_table *tab,
+				 pg_catalog_column *tabcol, int rownum,
+				 check_oid_cache *cache, bool zero_oid_ok);
+static inline void check_oid_array(pg_catalog_table *tab,
+				pg_catalog_column *tabcol, int rownum,
+				check_oid_cache *cache, bool zero_oid_ok);
+
+/*
+ * Specialized kernels for each kind of column, with and without zero_oid_ok,
+ * so that neither decision is made per row.
+ */
+#define DEFINE_OID_KERNEL(name, zero_oid_ok, body) \
+static void \
+name(check_step *step, pg_catalog_table *tab, int start, int end) \
+{ \
+	check_oid_cache *cache = step->state; \
+	pg_catalog_column *tabcol = step->tabcol; \
+	int			rownum; \
+\
+	for (rownum = start; rownum < end; ++rownum) \
+		body(tab, tabcol, rownum, cache, zero_oid_ok); \
+}
+
+DEFINE_OID_KERNEL(check_oid_kernel, false, check_one_oid)
+DEFINE_OID_KERNEL(check_oid_kernel_zero_ok, true, check_one_oid)
+DEFINE_OID_KERNEL(check_oid_vector_kernel, false, check_oid_vector)
+DEFINE_OID_KERNEL(check_oid_vector_kernel_zero_ok, true, check_oid_vector)
+DEFINE_OID_KERNEL(check_oid_array_kernel, false, check_oid_array)
+DEFINE_OID_KERNEL(check_oid_array_kernel_zero_ok, true, check_oid_array)
+
+static void
+check_oid_merge_kernel(check_step *step, pg_catalog_table *tab, int start,
+					   int end)
+{
+	check_oid_block_by_merge(step, tab, start, end, false);
+}
+
+static void
+check_oid_merge_kernel_zero_ok(check_step *step, pg_catalog_table *tab,
+							   int start, int end)
+{
+	check_oid_block_by_merge(step, tab, start, end, true);
+}
+
+static void
+check_oid_join_kernel(check_step *step, pg_catalog_table *tab, int start,
+					  int end)
+{
+	check_oid_block_by_join(step, tab, start, end, false);
+}
+
+static void
+check_oid_join_kernel_zero_ok(check_step *step, pg_catalog_table *tab,
+							  int start, int end)
+{
+	check_oid_block_by_join(step, tab, start, end, true);
+}
 
 /*
  * Set up for an OID referential integrity check.
@@ -35,185 +160,564 @@ prepare_to_check_oid_reference(pg_catalog_table *tab,
 }
 
 /*
- * Perform an OID referential integrity check.
+ * Compile an OID referential integrity check into a plan step.
+ *
+ * Returns false if there's nothing to check: the referenced table might not
+ * be available in this server version, or we might have failed to read it.
+ * There's actually one real case where the referenced table was adding later
+ * than referring table: pg_largeobject has existed for a long time, but
+ * pg_largeobject_metadata is newer.
  */
-void
-check_oid_reference(pg_catalog_table *tab, pg_catalog_column *tabcol,
-					int rownum)
+bool
+bind_oid_reference_check(pg_catalog_table *tab, pg_catalog_column *tabcol,
+						 check_step *step)
 {
 	pg_catalog_check_oid *check_oid = tabcol->check;
-	char	   *val = PQgetvalue(tab->data, rownum, tabcol->result_column);
-	pg_catalog_table *reftab;
+	check_oid_cache *cache;
 
 	/*
-	 * Find the hash table we need in order to perform the check.
-	 *
-	 * Since find_table_by_name is O(n) in the number of catalog tables being
-	 * checked, we cache the result, so that we only need to do that work
-	 * once.
+	 * The cache object holds the referenced table and the memo of recent
+	 * lookups.  It's kept in check_private so that the memo statistics can be
+	 * reported at the end.
 	 */
-	if (tabcol->check_private == NULL)
-	{
-		reftab = find_table_by_name(check_oid->oid_references_table);
-		tabcol->check_private = reftab;
-	}
-	else
-		reftab = tabcol->check_private;
+	cache = pg_malloc0(sizeof(check_oid_cache));
+	cache->reftab = find_table_by_name(check_oid->oid_references_table);
+	tabcol->check_private = cache;
 
-	/*
-	 * The table might not be available in this server version, or we might
-	 * have failed to read it.	There's actually one real case where the
-	 * referenced table was adding later than referring table: pg_largeobject
-	 * has existed for a long time, but pg_largeobject_metadata is newer.
-	 */
-	if (!reftab->ht)
-		return;
+	if (cache->reftab->ht == NULL && cache->reftab->oids == NULL)
+		return false;
 
+	step->state = cache;
 	switch (check_oid->type)
 	{
 		case CHECK_OID_REFERENCE:
 
 			/*
-			 * Simple OID reference.  Easy!
-			 *
-			 * We don't use do do_oid_check() here because the error message
-			 * is a little different in this case.
+			 * If another check asked for the rows this column refers to,
+			 * they've already been looked up, or will be anyway.
 			 */
+			if (tabcol->join_requests > 0 &&
+				tabcol->join_table == cache->reftab)
+				cache->join_index = get_join_index(tab, tabcol);
+			cache->join = (cache->join_index != NULL);
+			if (cache->join)
 			{
-				if (check_oid->zero_oid_ok && strcmp(val, "0") == 0)
-					return;
-				if (pgrhash_get(reftab->ht, &val) == -1)
-					pgcc_report(tab, tabcol, rownum,
-							"no matching entry in %s\n", reftab->table_name);
+				step->kernel = check_oid->zero_oid_ok ?
+					check_oid_join_kernel_zero_ok : check_oid_join_kernel;
+				break;
 			}
+			cache->merge = choose_merge(tab, cache->reftab);
+			if (cache->merge)
+				step->kernel = check_oid->zero_oid_ok ?
+					check_oid_merge_kernel_zero_ok : check_oid_merge_kernel;
+			else
+				step->kernel = check_oid->zero_oid_ok ?
+					check_oid_kernel_zero_ok : check_oid_kernel;
 			break;
-
 		case CHECK_OID_VECTOR_REFERENCE:
-			/* Space-separated list of values. */
-			{
-				char	   *s = val;
-				char		buf[32];
-
-				for (;;)
-				{
-					/* Find next word boundary. */
-					while (*s != '\0' && *s != ' ')
-						++s;
-
-					/* If it's the last word, we're done here! */
-					if (*s == '\0')
-					{
-						if (s > val)
-						{
-							/* If last entry is non-empty, check it. */
-							do_oid_check(tab, tabcol, rownum, check_oid,
-										 reftab, val);
-						}
-						break;
-					}
-
-					/* Make a copy of the data we need to check. */
-					if (s - val >= sizeof buf)
-					{
-						/* OIDs can't be this long. */
-						pgcc_report(tab, tabcol, rownum,
-							"contains a token of %ld characters\n", s - val);
-						return;
-					}
-					memcpy(buf, val, s - val);
-					buf[s - val] = '\0';
-
-					/* Check it and move ahead one character. */
-					do_oid_check(tab, tabcol, rownum, check_oid, reftab, buf);
-					val = ++s;
-				}
-			}
+			step->kernel = check_oid->zero_oid_ok ?
+				check_oid_vector_kernel_zero_ok : check_oid_vector_kernel;
 			break;
-
 		case CHECK_OID_ARRAY_REFERENCE:
-			/* Opening curly brace, comma-separated values, closing brace. */
-			{
-				char	   *s = val;
-				char		buf[32];
-				bool		bad = false;
-
-				/* Allow a completely empty field. */
-				if (*s == '\0')
-					break;
-
-				/* Otherwise, expect the opening delimeter. */
-				if (*s == '{')
-					val = ++s;
-				else
-					bad = true;
-
-				while (!bad)
-				{
-					/* Find next delimeter. */
-					while (*s != '\0' && *s != ',' && *s != '}')
-						++s;
-
-					/*
-					 * If we hit '\0' before '}', that's bad; and if we hit
-					 * two consecutive delimeters, that's also bad.
-					 */
-					if (val == s || *s == '\0')
-					{
-						bad = true;
-						break;
-					}
-
-					/* Make a copy of the data we need to check. */
-					if (s - val >= sizeof buf)
-					{
-						/* OIDs can't be this long. */
-						pgcc_report(tab, tabcol, rownum,
-							"contains a token of %ld characters\n", s - val);
-						return;
-					}
-					memcpy(buf, val, s - val);
-					buf[s - val] = '\0';
-
-					/* Check it. */
-					if (!check_oid->zero_oid_ok || strcmp(buf, "0") != 0)
-						do_oid_check(tab, tabcol, rownum, check_oid, reftab,
-									 buf);
-
-					/* Expect end of string if at '}'. */
-					if (*s == '}')
-					{
-						val = ++s;
-						if (*s != '\0')
-							bad = true;
-						break;
-					}
-
-					/* Skip comma and continue. */
-					val = ++s;
-				}
-
-				if (bad)
-					pgcc_report(tab, tabcol, rownum, "not a valid 1-D array");
-			}
+			step->kernel = check_oid->zero_oid_ok ?
+				check_oid_array_kernel_zero_ok : check_oid_array_kernel;
 			break;
-
 		default:
 			Assert(false);
-			break;
+			return false;
 	}
+
+	return true;
+}
+
+/*
+ * Simple OID reference.  Easy!
+ *
+ * The value is normally stored as an integer, so there's no text to look at
+ * unless it's malformed.
+ */
+static inline void
+check_one_oid(pg_catalog_table *tab, pg_catalog_column *tabcol, int rownum,
+			  check_oid_cache *cache, bool zero_oid_ok)
+{
+	uint32		oid;
+	bool		found;
+
+	if (colstore_get_integer(tab->store, rownum, tabcol->result_column, false,
+							 &oid))
+	{
+		if (zero_oid_ok && oid == 0)
+			return;
+		found = lookup_oid_value(cache, oid);
+	}
+	else
+		found = lookup_oid(cache, colstore_getvalue(tab->store, rownum,
+													tabcol->result_column));
+	if (!found)
+		pgcc_report(tab, tabcol, rownum,
+					"no matching entry in %s\n", cache->reftab->table_name);
 }
 
 /*
- * Check one of possibly several OIDs found in a single column.
+ * Record the next element of an OID vector or array, which is len bytes at
+ * start within the column value, converting it to an OID if it's
+ * well-formed.
+ */
+static inline void
+add_oid_token(check_oid_cache *cache, const char *start, size_t len)
+{
+	oid_token  *token;
+
+	if (cache->ntokens >= cache->ntokens_allocated)
+	{
+		cache->ntokens_allocated = Max(cache->ntokens_allocated * 2, 16);
+		cache->tokens = pg_realloc(cache->tokens,
+								   cache->ntokens_allocated *
+								   sizeof(oid_token));
+	}
+	token = &cache->tokens[cache->ntokens++];
+	token->start = start;
+	token->len = len;
+	token->valid = parse_integer_key_len(start, len, false, &token->oid);
+}
+
+/*
+ * Check the elements of an OID vector or array collected by add_oid_token(),
+ * reporting any that aren't found, in order.
+ *
+ * The well-formed elements are looked up together first, which keeps the
+ * memo and the referenced table's index hot.  An element that isn't a
+ * well-formed OID still gets looked up as text, as it always has, and then
+ * it needs a terminated copy.
  */
 static void
-do_oid_check(pg_catalog_table *tab, pg_catalog_column *tabcol, int rownum,
-			 pg_catalog_check_oid * check_oid,
-			 pg_catalog_table *reftab, char *value)
+check_oid_tokens(pg_catalog_table *tab, pg_catalog_column *tabcol,
+				 int rownum, check_oid_cache *cache, bool zero_oid_ok)
 {
-	if (check_oid->zero_oid_ok && strcmp(value, "0") == 0)
+	int			i;
+
+	for (i = 0; i < cache->ntokens; i++)
+	{
+		oid_token  *token = &cache->tokens[i];
+
+		if (!token->valid)
+			continue;
+		if (zero_oid_ok && token->oid == 0)
+			token->found = true;
+		else
+			token->found = lookup_oid_value(cache, token->oid);
+	}
+
+	for (i = 0; i < cache->ntokens; i++)
+	{
+		oid_token  *token = &cache->tokens[i];
+
+		if (!token->valid)
+		{
+			char	   *value = pg_malloc(token->len + 1);
+
+			memcpy(value, token->start, token->len);
+			value[token->len] = '\0';
+			token->found = lookup_oid(cache, value);
+			pg_free(value);
+		}
+		if (!token->found)
+			pgcc_report(tab, tabcol, rownum,
+						"\"%.*s\" not found in %s\n",
+						(int) token->len, token->start,
+						cache->reftab->table_name);
+	}
+
+	cache->ntokens = 0;
+}
+
+/*
+ * Check an OID vector: a space-separated list of values.
+ *
+ * The elements are located in place with strcspn(), which the C library
+ * implements a word or a vector at a time, and parsed where they lie.
+ */
+static inline void
+check_oid_vector(pg_catalog_table *tab, pg_catalog_column *tabcol,
+				 int rownum, check_oid_cache *cache, bool zero_oid_ok)
+{
+	char	   *s = colstore_getvalue(tab->store, rownum,
+									  tabcol->result_column);
+	size_t		too_long = 0;
+
+	for (;;)
+	{
+		/* Find next word boundary. */
+		size_t		len = strcspn(s, " ");
+
+		/* If it's the last word, we're done here! */
+		if (s[len] == '\0')
+		{
+			/* If last entry is non-empty, check it. */
+			if (len > 0)
+				add_oid_token(cache, s, len);
+			break;
+		}
+
+		/* OIDs can't be this long. */
+		if (len >= OID_TOKEN_MAX)
+		{
+			too_long = len;
+			break;
+		}
+
+		/* Collect it and move ahead one character. */
+		add_oid_token(cache, s, len);
+		s += len + 1;
+	}
+
+	check_oid_tokens(tab, tabcol, rownum, cache, zero_oid_ok);
+	if (too_long > 0)
+		pgcc_report(tab, tabcol, rownum,
+					"contains a token of %ld characters\n", (long) too_long);
+}
+
+/*
+ * Check an OID array: opening curly brace, comma-separated values, closing
+ * brace.
+ */
+static inline void
+check_oid_array(pg_catalog_table *tab, pg_catalog_column *tabcol,
+				int rownum, check_oid_cache *cache, bool zero_oid_ok)
+{
+	char	   *s = colstore_getvalue(tab->store, rownum,
+									  tabcol->result_column);
+	size_t		too_long = 0;
+	bool		bad = false;
+
+	/* Allow a completely empty field. */
+	if (*s == '\0')
 		return;
-	if (pgrhash_get(reftab->ht, &value) == -1)
+
+	/* Otherwise, expect the opening delimeter. */
+	if (*s == '{')
+		++s;
+	else
+		bad = true;
+
+	while (!bad)
+	{
+		/* Find next delimeter. */
+		size_t		len = strcspn(s, ",}");
+
+		/*
+		 * If we hit '\0' before '}', that's bad; and if we hit two
+		 * consecutive delimeters, that's also bad.
+		 */
+		if (len == 0 || s[len] == '\0')
+		{
+			bad = true;
+			break;
+		}
+
+		/* OIDs can't be this long. */
+		if (len >= OID_TOKEN_MAX)
+		{
+			too_long = len;
+			break;
+		}
+
+		/* Collect it. */
+		add_oid_token(cache, s, len);
+		s += len;
+
+		/* Expect end of string if at '}'. */
+		if (*s == '}')
+		{
+			if (s[1] != '\0')
+				bad = true;
+			break;
+		}
+
+		/* Skip comma and continue. */
+		++s;
+	}
+
+	check_oid_tokens(tab, tabcol, rownum, cache, zero_oid_ok);
+	if (too_long > 0)
+		pgcc_report(tab, tabcol, rownum,
+					"contains a token of %ld characters\n", (long) too_long);
+	else if (bad)
+		pgcc_report(tab, tabcol, rownum, "not a valid 1-D array");
+}
+
+/*
+ * Decide whether to check references from tab into reftab by merging rather
+ * than by hash probes.  That's only possible if reftab still has its rows and
+ * is keyed by OID, and only worthwhile if both tables are large; and then we
+ * need to build a sorted array of reftab's OIDs, unless some other check
+ * already did.
+ */
+static bool
+choose_merge(pg_catalog_table *tab, pg_catalog_table *reftab)
+{
+	int			oid_column;
+	int			nrows;
+	int			noids = 0;
+	int			rownum;
+	int			i;
+
+	if (reftab->sorted_oids != NULL)
+		return true;
+	if (reftab->ht == NULL || reftab->oids != NULL)
+		return false;
+
+	nrows = colstore_nrows(reftab->store);
+	if (nrows < MERGE_MIN_ROWS ||
+		Max(tab->estimated_rows, colstore_nrows(tab->store)) < nrows ||
+		(Size) nrows * sizeof(uint32) > MERGE_MEMORY_BUDGET)
+		return false;
+
+	oid_column = colstore_fnumber(reftab->store, "oid");
+	if (oid_column == -1)
+		return false;
+
+	/*
+	 * Only OIDs stored in canonical form could match a probe of the hash
+	 * table, so only those go into the array.
+	 */
+	reftab->sorted_oids = pg_malloc(nrows * sizeof(uint32));
+	for (rownum = 0; rownum < nrows; ++rownum)
+		if (colstore_get_integer(reftab->store, rownum, oid_column, false,
+								 &reftab->sorted_oids[noids]))
+			++noids;
+	radix_sort_oids(reftab->sorted_oids, NULL, noids);
+
+	/* Remove duplicates. */
+	for (i = 0, reftab->num_sorted_oids = 0; i < noids; ++i)
+		if (reftab->num_sorted_oids == 0 ||
+			reftab->sorted_oids[reftab->num_sorted_oids - 1] !=
+			reftab->sorted_oids[i])
+			reftab->sorted_oids[reftab->num_sorted_oids++] =
+				reftab->sorted_oids[i];
+
+	pgcc_log(PGCC_DEBUG,
+			 "sorted %d OIDs of table %s for merging with %s\n",
+			 reftab->num_sorted_oids, reftab->table_name, tab->table_name);
+	return true;
+}
+
+/*
+ * Check a block of simple OID references by merging.
+ *
+ * The well-formed values of the block are sorted, along with the rows they
+ * came from, and then matched against the referenced table's sorted OIDs in
+ * a single forward pass.  Reports therefore come out of row order, but
+ * they're held back until the end of the block and sorted before they're
+ * printed, so nobody can tell.  A malformed value goes through lookup_oid(),
+ * as it would if we weren't merging.
+ */
+static void
+check_oid_block_by_merge(check_step *step, pg_catalog_table *tab, int start,
+						 int end, bool zero_oid_ok)
+{
+	check_oid_cache *cache = step->state;
+	pg_catalog_column *tabcol = step->tabcol;
+	pg_catalog_table *reftab = cache->reftab;
+	int			n = 0;
+	int			pos = 0;
+	int			rownum;
+	int			i;
+
+	if (end - start > cache->nmerge_allocated)
+	{
+		cache->nmerge_allocated = end - start;
+		cache->merge_oids = pg_realloc(cache->merge_oids,
+									   cache->nmerge_allocated *
+									   sizeof(uint32));
+		cache->merge_rows = pg_realloc(cache->merge_rows,
+									   cache->nmerge_allocated *
+									   sizeof(int));
+	}
+
+	for (rownum = start; rownum < end; ++rownum)
+	{
+		uint32		oid;
+
+		if (colstore_get_integer(tab->store, rownum, tabcol->result_column,
+								 false, &oid))
+		{
+			if (zero_oid_ok && oid == 0)
+				continue;
+			cache->merge_oids[n] = oid;
+			cache->merge_rows[n] = rownum;
+			++n;
+		}
+		else if (!lookup_oid(cache,
+							 colstore_getvalue(tab->store, rownum,
+											   tabcol->result_column)))
+			pgcc_report(tab, tabcol, rownum,
+						"no matching entry in %s\n", reftab->table_name);
+	}
+
+	radix_sort_oids(cache->merge_oids, cache->merge_rows, n);
+	cache->lookups += n;
+
+	for (i = 0; i < n; ++i)
+	{
+		pos = gallop_to(reftab->sorted_oids, reftab->num_sorted_oids, pos,
+						cache->merge_oids[i]);
+		if (pos == reftab->num_sorted_oids ||
+			reftab->sorted_oids[pos] != cache->merge_oids[i])
+			pgcc_report(tab, tabcol, cache->merge_rows[i],
+						"no matching entry in %s\n", reftab->table_name);
+	}
+}
+
+/*
+ * Check a block of simple OID references against the join index, which
+ * already says which row of the referenced table, if any, each row refers
+ * to.
+ */
+static void
+check_oid_block_by_join(check_step *step, pg_catalog_table *tab, int start,
+						int end, bool zero_oid_ok)
+{
+	check_oid_cache *cache = step->state;
+	pg_catalog_column *tabcol = step->tabcol;
+	int			rownum;
+
+	cache->lookups += end - start;
+	for (rownum = start; rownum < end; ++rownum)
+	{
+		uint32		oid;
+
+		if (cache->join_index[rownum] != -1)
+			continue;
+		if (zero_oid_ok &&
+			colstore_get_integer(tab->store, rownum, tabcol->result_column,
+								 false, &oid) && oid == 0)
+			continue;
 		pgcc_report(tab, tabcol, rownum,
-					"\"%s\" not found in %s\n", value, reftab->table_name);
+					"no matching entry in %s\n", cache->reftab->table_name);
+	}
+}
+
+/*
+ * Find the first position at or after pos in a sorted array whose value is
+ * not less than oid, or noids if there is none.  We search forward in steps
+ * of increasing size before bisecting, so that the cost depends on how far
+ * we move, which for a merge is usually not far.
+ */
+static int
+gallop_to(const uint32 *oids, int noids, int pos, uint32 oid)
+{
+	int			lo = pos;
+	int			hi;
+	int			step = 1;
+
+	if (pos >= noids || oids[pos] >= oid)
+		return pos;
+
+	/* Invariant: oids[lo] < oid. */
+	while (lo + step < noids && oids[lo + step] < oid)
+	{
+		lo += step;
+		step <<= 1;
+	}
+	hi = Min(lo + step, noids);
+
+	/* The answer is in (lo, hi]. */
+	++lo;
+	while (lo < hi)
+	{
+		int			mid = lo + (hi - lo) / 2;
+
+		if (oids[mid] < oid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * Test whether a value appears in the referenced table, consulting the memo
+ * before the table's hash or OID set.
+ *
+ * Values that aren't well-formed OIDs bypass the memo; they're rare, and
+ * they'll simply fail to be found.  If the table has been reduced to an OID
+ * set, we know that all of its keys were well-formed.
+ */
+static bool
+lookup_oid(check_oid_cache *cache, char *value)
+{
+	uint32		oid;
+
+	if (!parse_integer_key(value, false, &oid))
+	{
+		cache->lookups++;
+		return cache->reftab->ht != NULL &&
+			pgrhash_get(cache->reftab->ht, &value) != -1;
+	}
+
+	return lookup_oid_value(cache, oid);
+}
+
+/*
+ * Test whether a well-formed OID appears in the referenced table.
+ */
+static bool
+lookup_oid_value(check_oid_cache *cache, uint32 oid)
+{
+	oid_memo_entry *entry;
+
+	cache->lookups++;
+
+	/* Fibonacci hashing: take the high bits of the product. */
+	entry = &cache->memo[(oid * 0x9e3779b9U) >> (32 - OID_MEMO_BITS)];
+	if (entry->valid && entry->oid == oid)
+	{
+		cache->memo_hits++;
+		return entry->found;
+	}
+
+	entry->oid = oid;
+	entry->valid = true;
+	if (cache->reftab->oids != NULL)
+		entry->found = oidset_contains(cache->reftab->oids, oid);
+	else
+		entry->found = (pgrhash_get_integer(cache->reftab->ht, &oid) != -1);
+	return entry->found;
+}
+
+/*
+ * Report how well the lookup memo worked for a column, if verbose mode is
+ * enabled.  Each memo hit is a hash probe we didn't have to make.
+ */
+void
+report_oid_reference_stats(pg_catalog_table *tab, pg_catalog_column *tabcol)
+{
+	check_oid_cache *cache = tabcol->check_private;
+
+	if (cache == NULL || cache->lookups == 0)
+		return;
+
+	if (cache->merge)
+	{
+		pgcc_log(PGCC_VERBOSE,
+				 "column %s.%s: " UINT64_FORMAT " lookups in %s answered by merging\n",
+				 tab->table_name, tabcol->name, cache->lookups,
+				 cache->reftab->table_name);
+		return;
+	}
+	if (cache->join)
+	{
+		pgcc_log(PGCC_VERBOSE,
+				 "column %s.%s: " UINT64_FORMAT " lookups in %s answered from join index\n",
+				 tab->table_name, tabcol->name, cache->lookups,
+				 cache->reftab->table_name);
+		return;
+	}
+
+	pgcc_log(PGCC_VERBOSE,
+			 "column %s.%s: " UINT64_FORMAT " of " UINT64_FORMAT " lookups in %s (%.1f%%) answered from memo\n",
+			 tab->table_name, tabcol->name, cache->memo_hits, cache->lookups,
+			 cache->reftab->table_name,
+			 100.0 * cache->memo_hits / cache->lookups);
 }
@@ -0,0 +1,189 @@
+/*-------------------------------------------------------------------------
+ *
+ * check_unique.c
+ *
+ * Checks for duplicates of unique keys other than the one we hash a table
+ * on, such as the name and namespace of each relation.
+ *
+ * Building a second hash table for each such key would double the memory
+ * needed for the largest catalogs.  Instead, we sort the rows by the key,
+ * so that duplicates end up next to each other.  colstore_get_code() gives
+ * us a 32-bit code for each value that's equal for two values of the same
+ * column exactly when the values are, so we never need to compare strings,
+ * and the sort can be a radix sort, one column at a time starting from the
+ * last; since each pass is stable, that leaves the rows ordered by the whole
+ * key.  The whole check takes linear time, and the few bytes per row it
+ * needs are freed as soon as the duplicates have been found.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include "pqexpbuffer.h"
+
+#include "pg_catcheck.h"
+
+typedef struct unique_key_cache
+{
+	char	   *key_names;		/* key column names, for messages */
+	int			nduplicates;	/* # of rows that duplicate an earlier one */
+	uint32	   *duplicates;		/* sorted row numbers of same */
+} unique_key_cache;
+
+static void check_unique_key_kernel(check_step *step, pg_catalog_table *tab,
+						int start, int end);
+
+/*
+ * Set up to check a unique key.
+ */
+void
+prepare_to_check_unique_key(pg_catalog_table *tab)
+{
+	pg_catalog_check_unique *check = tab->check;
+	char	  **colname;
+
+	/* Some keys weren't unique in older versions. */
+	if (remote_version < check->minimum_version)
+	{
+		tab->row_check_enabled = false;
+		return;
+	}
+
+	for (colname = check->columns; *colname != NULL; ++colname)
+	{
+		pg_catalog_column *tabcol = find_column_by_name(tab, *colname);
+
+		if (tabcol->available)
+			tabcol->needed = true;
+	}
+
+	/* We need all the rows at once. */
+	tab->needs_all_rows = true;
+}
+
+/*
+ * Compile a unique key check into a plan step.
+ *
+ * This is where we find the duplicates, since doing so takes all of the
+ * table's rows; the kernel just reports them.  Returns false if the columns
+ * of the key are missing.
+ */
+bool
+bind_unique_key_check(pg_catalog_table *tab, check_step *step)
+{
+	pg_catalog_check_unique *check = tab->check;
+	unique_key_cache *cache;
+	int			keycols[MAX_UNIQUE_KEY_COLS];
+	int			nkeycols = 0;
+	PQExpBufferData key_names;
+	char	  **colname;
+	int			ntups = colstore_nrows(tab->store);
+	int		   *rows;
+	uint32	   *codes;
+	int			nallocated = 0;
+	int			i;
+	int			k;
+
+	initPQExpBuffer(&key_names);
+	for (colname = check->columns; *colname != NULL; ++colname)
+	{
+		if (!find_column_by_name(tab, *colname)->available)
+			continue;
+		keycols[nkeycols] = colstore_fnumber(tab->store, *colname);
+		if (keycols[nkeycols] == -1)
+		{
+			termPQExpBuffer(&key_names);
+			return false;
+		}
+		appendPQExpBuffer(&key_names, "%s%s", nkeycols > 0 ? ", " : "",
+						  *colname);
+		nkeycols++;
+	}
+	if (nkeycols == 0)
+	{
+		termPQExpBuffer(&key_names);
+		return false;
+	}
+
+	cache = pg_malloc(sizeof(unique_key_cache));
+	cache->key_names = pg_strdup(key_names.data);
+	cache->nduplicates = 0;
+	cache->duplicates = NULL;
+	termPQExpBuffer(&key_names);
+
+	/* Sort the rows by the key, last column first. */
+	rows = pg_malloc(Max(ntups, 1) * sizeof(int));
+	codes = pg_malloc(Max(ntups, 1) * sizeof(uint32));
+	for (i = 0; i < ntups; i++)
+		rows[i] = i;
+	for (k = nkeycols - 1; k >= 0; k--)
+	{
+		for (i = 0; i < ntups; i++)
+			codes[i] = colstore_get_code(tab->store, rows[i], keycols[k]);
+		radix_sort_oids(codes, rows, ntups);
+	}
+
+	/*
+	 * Rows with the same key are now adjacent, and since the sort is stable,
+	 * in their original order.  Each but the first of them is a duplicate.
+	 */
+	for (i = 1; i < ntups; i++)
+	{
+		for (k = 0; k < nkeycols; k++)
+			if (colstore_get_code(tab->store, rows[i - 1], keycols[k]) !=
+				colstore_get_code(tab->store, rows[i], keycols[k]))
+				break;
+		if (k < nkeycols)
+			continue;
+
+		if (cache->nduplicates >= nallocated)
+		{
+			nallocated = Max(nallocated * 2, 16);
+			cache->duplicates = pg_realloc(cache->duplicates,
+										   nallocated * sizeof(uint32));
+		}
+		cache->duplicates[cache->nduplicates++] = rows[i];
+	}
+	radix_sort_oids(cache->duplicates, NULL, cache->nduplicates);
+
+	pg_free(rows);
+	pg_free(codes);
+
+	pgcc_log(PGCC_DEBUG,
+			 "sorted %d rows of table %s on unique key (%s)\n",
+			 ntups, tab->table_name, cache->key_names);
+
+	step->state = cache;
+	step->kernel = check_unique_key_kernel;
+	return true;
+}
+
+/*
+ * Report the rows in the range that duplicate the key of an earlier row.
+ */
+static void
+check_unique_key_kernel(check_step *step, pg_catalog_table *tab,
+						int start, int end)
+{
+	unique_key_cache *cache = step->state;
+	int			lo = 0;
+	int			hi = cache->nduplicates;
+
+	/* Find the first duplicate at or after the start of the range. */
+	while (lo < hi)
+	{
+		int			mid = (lo + hi) / 2;
+
+		if (cache->duplicates[mid] < (uint32) start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < cache->nduplicates && cache->duplicates[lo] < (uint32) end;
+		 lo++)
+		pgcc_report(tab, NULL, cache->duplicates[lo],
+					"%s row duplicates existing unique key (%s)\n",
+					tab->table_name, cache->key_names);
+}
@@ -0,0 +1,380 @@
+/*-------------------------------------------------------------------------
+ *
+ * checkpoint.c
+ *
+ * Checkpoints, so that a long run that's interrupted can be resumed.  With
+ * --checkpoint=FILE, each time we finish checking a table we record in FILE
+ * which tables have been checked and how many inconsistencies each had.
+ * With --resume as well, a new run picks up where the file says the old one
+ * left off: the tables it finished aren't checked again, and aren't loaded at
+ * all unless a table that's still to be checked refers to them.  Their
+ * inconsistencies are counted again, so that the summary at the end, and the
+ * exit status, cover both runs, but the reports themselves are only in the
+ * first run's output.  Warnings and errors don't carry over, since they
+ * concern the tables we're about to try again.
+ *
+ * There's no way to carry a snapshot over from one connection to the next,
+ * so the resumed run sees the catalogs as they are when it starts.  We do
+ * keep the xmin horizon of the original run, so that we can say, when
+ * resuming, how far back the checked tables were read.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include "pqexpbuffer.h"
+
+#include "pg_catcheck.h"
+
+#define CHECKPOINT_FILE_HEADER		"pg_catcheck-checkpoint"
+#define CHECKPOINT_FILE_VERSION		1
+
+/* Longest plan description we'll read back. */
+#define MAX_PLAN_LENGTH				65536
+
+static char *checkpoint_path = NULL;
+static bool *finished;			/* indexed like pg_catalog_tables */
+static int *previous_inconsistencies;	/* found by the run we're resuming */
+static pg_catalog_table ***needs;	/* tables each table's checks refer to */
+static int *num_needs;
+static char horizon[32] = "0";	/* of the original run, if known */
+static char *plan;				/* what this run is checking */
+static bool wrote_checkpoint = false;
+
+static bool table_finished(pg_catalog_table *tab);
+static bool read_checkpoint(FILE *f);
+static char *describe_plan(void);
+
+/*
+ * Start writing checkpoints, and if resuming, read the last one.  Call once
+ * we know which checks we're going to run, but before running any.
+ */
+void
+begin_checkpoints(PGconn *conn, char *path, bool resume)
+{
+	PGresult   *res;
+	pg_catalog_table *tab;
+	int			ntables = 0;
+	FILE	   *f;
+
+	checkpoint_path = path;
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+		ntables++;
+	finished = pg_malloc0(ntables * sizeof(bool));
+	previous_inconsistencies = pg_malloc0(ntables * sizeof(int));
+	plan = describe_plan();
+
+	/*
+	 * Loading a table removes it from the lists of tables that others need,
+	 * so keep copies, to check later that each table's checks had everything
+	 * they refer to.
+	 */
+	needs = pg_malloc0(ntables * sizeof(pg_catalog_table **));
+	num_needs = pg_malloc0(ntables * sizeof(int));
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+	{
+		int			i = tab - pg_catalog_tables;
+
+		if (tab->num_needs == 0)
+			continue;
+		needs[i] = pg_malloc(tab->num_needs * sizeof(pg_catalog_table *));
+		memcpy(needs[i], tab->needs,
+			   tab->num_needs * sizeof(pg_catalog_table *));
+		num_needs[i] = tab->num_needs;
+	}
+
+	res = PQexec(conn,
+				 "SELECT pg_catalog.txid_snapshot_xmin(pg_catalog.txid_current_snapshot())");
+	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+		strlcpy(horizon, PQgetvalue(res, 0, 0), sizeof(horizon));
+	PQclear(res);
+
+	if (!resume)
+		return;
+
+	f = fopen(checkpoint_path, "r");
+	if (f == NULL)
+	{
+		if (errno != ENOENT)
+			pgcc_log(PGCC_WARNING,
+					 "could not open checkpoint file \"%s\": %s\n",
+					 checkpoint_path, strerror(errno));
+		else
+			pgcc_log(PGCC_PROGRESS,
+					 "no checkpoint file \"%s\"; starting from the beginning\n",
+					 checkpoint_path);
+		return;
+	}
+	if (!read_checkpoint(f))
+	{
+		memset(finished, 0, ntables * sizeof(bool));
+		memset(previous_inconsistencies, 0, ntables * sizeof(int));
+	}
+	fclose(f);
+
+	/* Tables we've finished with don't need anything loaded for them. */
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+		if (finished[tab - pg_catalog_tables])
+			drop_table_dependencies(tab);
+}
+
+/*
+ * Did the run we're resuming finish checking this table?
+ */
+bool
+table_already_checked(pg_catalog_table *tab)
+{
+	return checkpoint_path != NULL && finished[tab - pg_catalog_tables];
+}
+
+/*
+ * Record which tables have been checked so far.  A table counts once we've
+ * run its checks over all its rows; if it, or a table it refers to, couldn't
+ * be loaded, it doesn't, so that a resumed run will try again.
+ *
+ * We write a new file and rename it over the old one, so that being
+ * interrupted while writing it doesn't leave us without a checkpoint.
+ */
+void
+save_checkpoint(void)
+{
+	PQExpBuffer temp_path = createPQExpBuffer();
+	pg_catalog_table *tab;
+	FILE	   *f;
+
+	appendPQExpBuffer(temp_path, "%s.tmp", checkpoint_path);
+	f = fopen(temp_path->data, "w");
+	if (f == NULL)
+	{
+		pgcc_log(PGCC_WARNING, "could not create checkpoint file \"%s\": %s\n",
+				 temp_path->data, strerror(errno));
+		destroyPQExpBuffer(temp_path);
+		return;
+	}
+
+	fprintf(f, "%s %d\n", CHECKPOINT_FILE_HEADER, CHECKPOINT_FILE_VERSION);
+	fprintf(f, "database %s %d %d\n",
+			database_oid != NULL ? database_oid : "0", remote_version,
+			(int) remote_is_edb);
+	fprintf(f, "horizon %s\n", horizon);
+	fprintf(f, "plan %s\n", plan);
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+	{
+		int			t = tab - pg_catalog_tables;
+
+		if (!finished[t] && table_finished(tab))
+		{
+			finished[t] = true;
+			previous_inconsistencies[t] = tab->inconsistencies;
+		}
+		if (finished[t])
+			fprintf(f, "checked %s %d\n", tab->table_name,
+					previous_inconsistencies[t]);
+	}
+	fprintf(f, "end\n");
+
+	if (ferror(f) | (fclose(f) != 0))
+	{
+		pgcc_log(PGCC_WARNING, "could not write checkpoint file \"%s\"\n",
+				 temp_path->data);
+		remove(temp_path->data);
+	}
+	else if (rename(temp_path->data, checkpoint_path) != 0)
+		pgcc_log(PGCC_WARNING, "could not rename \"%s\" to \"%s\": %s\n",
+				 temp_path->data, checkpoint_path, strerror(errno));
+	else
+		wrote_checkpoint = true;
+
+	destroyPQExpBuffer(temp_path);
+}
+
+/*
+ * At the end of a run, the checkpoint has served its purpose, unless some
+ * tables couldn't be checked; then we keep it, so that --resume can retry
+ * just those.
+ */
+void
+finish_checkpoints(void)
+{
+	if (!wrote_checkpoint)
+		return;
+
+	if (pgcc_log_had_errors())
+	{
+		pgcc_log(PGCC_PROGRESS,
+				 "keeping checkpoint file \"%s\"; use --resume to retry the tables that could not be checked\n",
+				 checkpoint_path);
+		return;
+	}
+
+	if (remove(checkpoint_path) != 0)
+		pgcc_log(PGCC_WARNING, "could not remove checkpoint file \"%s\": %s\n",
+				 checkpoint_path, strerror(errno));
+}
+
+/*
+ * Have we checked this table, in this run or the one we're resuming?
+ *
+ * A check that refers to a table we couldn't load doesn't complain about the
+ * references it can't resolve, so the table isn't finished with unless
+ * everything it refers to was loaded.
+ */
+static bool
+table_finished(pg_catalog_table *tab)
+{
+	int			t = tab - pg_catalog_tables;
+	int			i;
+
+	if (finished[t])
+		return true;
+	if (!tab->check_complete)
+		return false;
+	for (i = 0; i < num_needs[t]; ++i)
+		if (needs[t][i]->store == NULL && needs[t][i]->oids == NULL)
+			return false;
+	return true;
+}
+
+/*
+ * Read the checkpoint left by an interrupted run.  Returns false if there
+ * isn't one we can use, in which case we start from the beginning.
+ *
+ * The file is a sequence of whitespace-separated tokens:
+ *
+ *	pg_catcheck-checkpoint VERSION
+ *	database OID SERVER_VERSION IS_EDB
+ *	horizon XID
+ *	plan PLAN
+ *	checked TABLE INCONSISTENCIES	(once per table checked)
+ *	end
+ */
+static bool
+read_checkpoint(FILE *f)
+{
+	char		word[NAMEDATALEN * 4];
+	int			version;
+	char		dboid[32];
+	int			server_version;
+	int			is_edb;
+	char		old_horizon[32];
+	char	   *old_plan = pg_malloc(MAX_PLAN_LENGTH);
+	bool		same_plan;
+	int			ninconsistencies = 0;
+	int			nfinished = 0;
+
+	if (fscanf(f, "%255s %d", word, &version) != 2 ||
+		strcmp(word, CHECKPOINT_FILE_HEADER) != 0 ||
+		version != CHECKPOINT_FILE_VERSION ||
+		fscanf(f, " database %31s %d %d", dboid, &server_version,
+			   &is_edb) != 3 ||
+		fscanf(f, " horizon %31s", old_horizon) != 1 ||
+		fscanf(f, " plan %65535s", old_plan) != 1)
+		goto bad;
+
+	/* The checkpoint is only any use for the same checks of the same database. */
+	same_plan = strcmp(old_plan, plan) == 0;
+	pg_free(old_plan);
+	old_plan = NULL;
+	if (strcmp(dboid, database_oid != NULL ? database_oid : "0") != 0 ||
+		server_version != remote_version || is_edb != (int) remote_is_edb ||
+		!same_plan)
+	{
+		pgcc_log(PGCC_WARNING,
+				 "checkpoint file \"%s\" is for a different database or different checks; starting from the beginning\n",
+				 checkpoint_path);
+		return false;
+	}
+
+	while (fscanf(f, "%255s", word) == 1)
+	{
+		char		table_name[NAMEDATALEN * 4];
+		int			count;
+		pg_catalog_table *tab;
+
+		if (strcmp(word, "end") == 0)
+		{
+			strlcpy(horizon, old_horizon, sizeof(horizon));
+			pgcc_log_add_inconsistencies(ninconsistencies);
+			pgcc_log(PGCC_PROGRESS,
+					 "resuming from checkpoint: %d tables already checked (%d inconsistencies)\n",
+					 nfinished, ninconsistencies);
+			pgcc_log(PGCC_VERBOSE,
+					 "tables already checked were read as of transaction %s\n",
+					 horizon);
+			return true;
+		}
+		if (strcmp(word, "checked") != 0 ||
+			fscanf(f, "%255s %d", table_name, &count) != 2 || count < 0)
+			goto bad;
+		for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+			if (strcmp(tab->table_name, table_name) == 0)
+				break;
+		if (tab->table_name == NULL)
+			goto bad;
+		if (finished[tab - pg_catalog_tables])
+			goto bad;
+		finished[tab - pg_catalog_tables] = true;
+		previous_inconsistencies[tab - pg_catalog_tables] = count;
+		ninconsistencies += count;
+		nfinished++;
+	}
+
+bad:
+	if (old_plan != NULL)
+		pg_free(old_plan);
+	pgcc_log(PGCC_WARNING,
+			 "checkpoint file \"%s\" is invalid; starting from the beginning\n",
+			 checkpoint_path);
+	return false;
+}
+
+/*
+ * Describe the checks this run will perform, as a single token: for each
+ * table with anything to check, its name, the columns to be checked, and
+ * whether its table-level check is to be run.  A checkpoint only applies to
+ * a run performing exactly the same checks.
+ */
+static char *
+describe_plan(void)
+{
+	PQExpBufferData buf;
+	pg_catalog_table *tab;
+	char	   *result;
+
+	initPQExpBuffer(&buf);
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+	{
+		pg_catalog_column *tabcol;
+		int			len = buf.len;
+		bool		any = false;
+
+		appendPQExpBuffer(&buf, "%s%s:", len > 0 ? ";" : "",
+						  tab->table_name);
+		for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+		{
+			if (tabcol->checked != TRI_YES)
+				continue;
+			appendPQExpBuffer(&buf, "%s%s", any ? "," : "", tabcol->name);
+			any = true;
+		}
+		if (tab->row_check_enabled)
+		{
+			appendPQExpBufferStr(&buf, "+table");
+			any = true;
+		}
+
+		/* Leave out tables with nothing to check. */
+		if (!any)
+		{
+			buf.len = len;
+			buf.data[len] = '\0';
+		}
+	}
+	if (buf.len == 0)
+		appendPQExpBufferStr(&buf, "-");
+	result = pg_strdup(buf.data);
+	termPQExpBuffer(&buf);
+
+	return result;
+}
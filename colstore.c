@@ -0,0 +1,620 @@
+/*-------------------------------------------------------------------------
+ *
+ * colstore.c
+ *
+ * Column-oriented storage for the rows of a catalog table.
+ *
+ * libpq hands us every value as a separately allocated string, which for
+ * the large catalogs costs far more memory than the data itself and
+ * scatters each column across the heap.  Instead, as each result arrives,
+ * we convert it into one array per column and free it.  Columns of type
+ * oid, int2 and int4 are stored as integers of the corresponding width, and
+ * "char" and bool columns as single bytes; everything else is stored as an
+ * offset into a pool of strings, in which each distinct string is kept only
+ * once, since values such as namespace and owner names repeat endlessly.
+ *
+ * A typed column is kept typed only as long as every value in it is the
+ * canonical text form of its type, so that converting a value back to text
+ * always reproduces exactly what the server sent.  A null, or anything
+ * unexpected, demotes the column to strings.  As with libpq, a null reads
+ * back as an empty string.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include "pg_catcheck.h"
+
+#if PG_VERSION_NUM >= 110000
+#include "catalog/pg_type_d.h"
+#else
+#include "catalog/pg_type.h"
+#endif
+
+/*
+ * colstore_getvalue() formats integers into a ring of buffers, so that a
+ * caller can hold on to this many values at once.
+ */
+#define COLSTORE_RING_SIZE		64
+#define COLSTORE_INT_BUFSIZE	12
+
+typedef enum colstore_kind
+{
+	COLSTORE_OID,				/* uint32 */
+	COLSTORE_INT2,				/* int16 */
+	COLSTORE_INT4,				/* int32 */
+	COLSTORE_CHAR,				/* char; '\0' reads back as "" */
+	COLSTORE_TEXT				/* uint32 offset into string pool */
+} colstore_kind;
+
+typedef struct colstore_column
+{
+	char	   *name;			/* column name, as from PQfname() */
+	Oid			typid;			/* type, as from PQftype() */
+	colstore_kind kind;
+	void	   *values;			/* array of nrows_allocated values */
+} colstore_column;
+
+struct colstore
+{
+	int			ncolumns;
+	colstore_column *columns;
+	int			nrows;
+	int			nrows_allocated;
+
+	/* Pool of distinct NUL-terminated strings. */
+	char	   *pool;
+	uint32		pool_used;
+	uint32		pool_allocated;
+
+	/* Open-addressed index of the pool: offset + 1, or 0 if empty. */
+	uint32	   *intern;
+	uint32		intern_size;	/* power of two */
+	uint32		intern_used;
+};
+
+static Size kind_width(colstore_kind kind);
+static void append_column(colstore *cs, colstore_column *col, PGresult *res,
+			  int colno, int ntups);
+static void demote_column(colstore *cs, colstore_column *col, int nvalues);
+static char *value_text(colstore *cs, colstore_column *col, int rownum,
+		   char *buf);
+static uint32 intern_string(colstore *cs, const char *value);
+static void intern_grow(colstore *cs);
+static uint32 string_hash_fnv1a(const char *s);
+static void colstore_reserve(colstore *cs, int nrows);
+
+/*
+ * Create an empty store with the same columns as the given result, with room
+ * for expected_rows rows to start with.
+ */
+colstore *
+colstore_create(PGresult *res, int expected_rows)
+{
+	colstore   *cs;
+	int			i;
+
+	cs = pg_malloc0(sizeof(colstore));
+	cs->ncolumns = PQnfields(res);
+	cs->columns = pg_malloc0(Max(cs->ncolumns, 1) * sizeof(colstore_column));
+	for (i = 0; i < cs->ncolumns; i++)
+	{
+		colstore_column *col = &cs->columns[i];
+
+		col->name = pg_strdup(PQfname(res, i));
+		col->typid = PQftype(res, i);
+		switch (col->typid)
+		{
+			case OIDOID:
+				col->kind = COLSTORE_OID;
+				break;
+			case INT2OID:
+				col->kind = COLSTORE_INT2;
+				break;
+			case INT4OID:
+				col->kind = COLSTORE_INT4;
+				break;
+			case CHAROID:
+			case BOOLOID:
+				col->kind = COLSTORE_CHAR;
+				break;
+			default:
+				col->kind = COLSTORE_TEXT;
+				break;
+		}
+	}
+
+	cs->intern_size = 256;
+	cs->intern = pg_malloc0(cs->intern_size * sizeof(uint32));
+	colstore_truncate(cs);
+	colstore_reserve(cs, Max(expected_rows, 16));
+
+	return cs;
+}
+
+/*
+ * Free a store.
+ */
+void
+colstore_destroy(colstore *cs)
+{
+	int			i;
+
+	for (i = 0; i < cs->ncolumns; i++)
+	{
+		pg_free(cs->columns[i].name);
+		if (cs->columns[i].values != NULL)
+			pg_free(cs->columns[i].values);
+	}
+	pg_free(cs->columns);
+	if (cs->pool != NULL)
+		pg_free(cs->pool);
+	pg_free(cs->intern);
+	pg_free(cs);
+}
+
+/*
+ * Discard all rows, keeping the columns and the memory allocated for them.
+ * Strings returned by colstore_getvalue() before this call are invalidated.
+ */
+void
+colstore_truncate(colstore *cs)
+{
+	cs->nrows = 0;
+	cs->pool_used = 0;
+	cs->intern_used = 0;
+	memset(cs->intern, 0, cs->intern_size * sizeof(uint32));
+
+	/* Offset 0 is always the empty string. */
+	intern_string(cs, "");
+}
+
+/*
+ * Append every row of a result, which must have the same columns as the one
+ * the store was created from.  The caller may PQclear() it afterwards.
+ *
+ * This may move the string pool, so strings previously returned by
+ * colstore_getvalue() should not be used after calling it.
+ */
+void
+colstore_append(colstore *cs, PGresult *res)
+{
+	int			ntups = PQntuples(res);
+	int			i;
+
+	Assert(PQnfields(res) == cs->ncolumns);
+
+	colstore_reserve(cs, cs->nrows + ntups);
+	for (i = 0; i < cs->ncolumns; i++)
+		append_column(cs, &cs->columns[i], res, i, ntups);
+	cs->nrows += ntups;
+}
+
+/*
+ * Number of rows in the store.
+ */
+int
+colstore_nrows(colstore *cs)
+{
+	return cs->nrows;
+}
+
+/*
+ * Column number for a column name, or -1 if there's no such column.  Like
+ * PQfnumber(), this also returns -1 if there's no store at all.
+ */
+int
+colstore_fnumber(colstore *cs, const char *name)
+{
+	int			i;
+
+	if (cs == NULL)
+		return -1;
+	for (i = 0; i < cs->ncolumns; i++)
+		if (strcmp(cs->columns[i].name, name) == 0)
+			return i;
+	return -1;
+}
+
+/*
+ * Type OID of a column, as reported by the server.
+ */
+Oid
+colstore_ftype(colstore *cs, int colno)
+{
+	Assert(colno >= 0 && colno < cs->ncolumns);
+	return cs->columns[colno].typid;
+}
+
+/*
+ * Fetch a value in text form, exactly as the server sent it.
+ *
+ * A string value points into the store's pool and remains valid until rows
+ * are next appended or discarded; an integer value is formatted into one of
+ * a ring of static buffers, and so remains valid for at least the next
+ * COLSTORE_RING_SIZE - 1 calls.
+ */
+char *
+colstore_getvalue(colstore *cs, int rownum, int colno)
+{
+	static char ring[COLSTORE_RING_SIZE][COLSTORE_INT_BUFSIZE];
+	static int	ring_next = 0;
+	char	   *buf;
+
+	Assert(rownum >= 0 && rownum < cs->nrows);
+	Assert(colno >= 0 && colno < cs->ncolumns);
+
+	buf = ring[ring_next];
+	ring_next = (ring_next + 1) % COLSTORE_RING_SIZE;
+	return value_text(cs, &cs->columns[colno], rownum, buf);
+}
+
+/*
+ * Fetch a value as an integer, with the same result as applying
+ * parse_integer_key() to its text form, but without going through text for
+ * the columns that are stored as integers of the matching signedness.
+ */
+bool
+colstore_get_integer(colstore *cs, int rownum, int colno, bool is_signed,
+					 uint32 *result)
+{
+	colstore_column *col;
+
+	Assert(rownum >= 0 && rownum < cs->nrows);
+	Assert(colno >= 0 && colno < cs->ncolumns);
+	col = &cs->columns[colno];
+
+	if (col->kind == COLSTORE_OID && !is_signed)
+	{
+		*result = ((uint32 *) col->values)[rownum];
+		return true;
+	}
+	if (col->kind == COLSTORE_INT2 && is_signed)
+	{
+		*result = (uint32) (int32) ((int16 *) col->values)[rownum];
+		return true;
+	}
+	if (col->kind == COLSTORE_INT4 && is_signed)
+	{
+		*result = (uint32) ((int32 *) col->values)[rownum];
+		return true;
+	}
+
+	return parse_integer_key(colstore_getvalue(cs, rownum, colno), is_signed,
+							 result);
+}
+
+/*
+ * Fetch a code for a value, such that two values of the same column have the
+ * same code exactly when their text forms are equal.  For a column stored as
+ * integers that's just the value; for a string, it's the offset of the
+ * string in the pool, which like the string itself remains valid until rows
+ * are next appended or discarded.
+ */
+uint32
+colstore_get_code(colstore *cs, int rownum, int colno)
+{
+	colstore_column *col;
+
+	Assert(rownum >= 0 && rownum < cs->nrows);
+	Assert(colno >= 0 && colno < cs->ncolumns);
+	col = &cs->columns[colno];
+
+	switch (col->kind)
+	{
+		case COLSTORE_OID:
+			return ((uint32 *) col->values)[rownum];
+		case COLSTORE_INT2:
+			return (uint32) (int32) ((int16 *) col->values)[rownum];
+		case COLSTORE_INT4:
+			return (uint32) ((int32 *) col->values)[rownum];
+		case COLSTORE_CHAR:
+			return ((unsigned char *) col->values)[rownum];
+		case COLSTORE_TEXT:
+			break;
+	}
+
+	return ((uint32 *) col->values)[rownum];
+}
+
+/*
+ * Bytes of memory allocated for the store.
+ */
+Size
+colstore_memory(colstore *cs)
+{
+	Size		total;
+	int			i;
+
+	total = sizeof(colstore) + cs->ncolumns * sizeof(colstore_column);
+	for (i = 0; i < cs->ncolumns; i++)
+		total += cs->nrows_allocated * kind_width(cs->columns[i].kind);
+	total += cs->pool_allocated;
+	total += cs->intern_size * sizeof(uint32);
+
+	return total;
+}
+
+/*
+ * Size in bytes of one value of the given kind.
+ */
+static Size
+kind_width(colstore_kind kind)
+{
+	switch (kind)
+	{
+		case COLSTORE_INT2:
+			return sizeof(int16);
+		case COLSTORE_CHAR:
+			return sizeof(char);
+		case COLSTORE_OID:
+		case COLSTORE_INT4:
+		case COLSTORE_TEXT:
+			break;
+	}
+	return sizeof(uint32);
+}
+
+/*
+ * Make room for at least nrows rows.
+ */
+static void
+colstore_reserve(colstore *cs, int nrows)
+{
+	int			i;
+
+	if (nrows <= cs->nrows_allocated)
+		return;
+
+	if (cs->nrows_allocated > PG_INT32_MAX / 2)
+		pgcc_log(PGCC_FATAL, "too many tuples");
+	nrows = Max(nrows, cs->nrows_allocated * 2);
+	for (i = 0; i < cs->ncolumns; i++)
+	{
+		colstore_column *col = &cs->columns[i];
+
+		col->values = pg_realloc(col->values,
+								 Max(nrows, 1) * kind_width(col->kind));
+	}
+	cs->nrows_allocated = nrows;
+}
+
+/*
+ * Convert one column of a result into rows cs->nrows onwards of the store.
+ *
+ * Each kind of typed column is converted by its own loop over the whole
+ * column, using the lengths libpq already knows.  If we reach a value that
+ * can't be stored in the column's type, the values converted so far are
+ * moved to the string pool, and the rest of the column is stored as text.
+ */
+static void
+append_column(colstore *cs, colstore_column *col, PGresult *res, int colno,
+			  int ntups)
+{
+	int			r = 0;
+	uint32		word;
+
+	switch (col->kind)
+	{
+		case COLSTORE_OID:
+			{
+				uint32	   *values = (uint32 *) col->values + cs->nrows;
+
+				for (; r < ntups; r++)
+					if (PQgetisnull(res, r, colno) ||
+						!parse_integer_key_len(PQgetvalue(res, r, colno),
+											   PQgetlength(res, r, colno),
+											   false, &values[r]))
+						break;
+			}
+			break;
+		case COLSTORE_INT2:
+			{
+				int16	   *values = (int16 *) col->values + cs->nrows;
+
+				for (; r < ntups; r++)
+				{
+					if (PQgetisnull(res, r, colno) ||
+						!parse_integer_key_len(PQgetvalue(res, r, colno),
+											   PQgetlength(res, r, colno),
+											   true, &word) ||
+						(int32) word < PG_INT16_MIN ||
+						(int32) word > PG_INT16_MAX)
+						break;
+					values[r] = (int16) (int32) word;
+				}
+			}
+			break;
+		case COLSTORE_INT4:
+			{
+				int32	   *values = (int32 *) col->values + cs->nrows;
+
+				for (; r < ntups; r++)
+				{
+					if (PQgetisnull(res, r, colno) ||
+						!parse_integer_key_len(PQgetvalue(res, r, colno),
+											   PQgetlength(res, r, colno),
+											   true, &word))
+						break;
+					values[r] = (int32) word;
+				}
+			}
+			break;
+		case COLSTORE_CHAR:
+			{
+				char	   *values = (char *) col->values + cs->nrows;
+
+				/*
+				 * Non-ASCII "char" values come back escaped, as several
+				 * bytes.
+				 */
+				for (; r < ntups; r++)
+				{
+					if (PQgetisnull(res, r, colno) ||
+						PQgetlength(res, r, colno) > 1)
+						break;
+					values[r] = *PQgetvalue(res, r, colno);
+				}
+			}
+			break;
+		case COLSTORE_TEXT:
+			break;
+	}
+
+	if (r < ntups && col->kind != COLSTORE_TEXT)
+		demote_column(cs, col, cs->nrows + r);
+	for (; r < ntups; r++)
+		((uint32 *) col->values)[cs->nrows + r] =
+			intern_string(cs, PQgetvalue(res, r, colno));
+}
+
+/*
+ * Convert a typed column to strings, re-storing the values of its first
+ * nvalues rows in the pool.
+ */
+static void
+demote_column(colstore *cs, colstore_column *col, int nvalues)
+{
+	uint32	   *offsets;
+	int			rownum;
+
+	offsets = pg_malloc(Max(cs->nrows_allocated, 1) * sizeof(uint32));
+	for (rownum = 0; rownum < nvalues; rownum++)
+	{
+		char		buf[COLSTORE_INT_BUFSIZE];
+
+		offsets[rownum] = intern_string(cs,
+										value_text(cs, col, rownum, buf));
+	}
+
+	pgcc_log(PGCC_DEBUG, "storing column %s as text\n", col->name);
+	pg_free(col->values);
+	col->values = offsets;
+	col->kind = COLSTORE_TEXT;
+}
+
+/*
+ * Return the text form of a value.  Integers are formatted into buf, which
+ * must have room for COLSTORE_INT_BUFSIZE bytes.
+ */
+static char *
+value_text(colstore *cs, colstore_column *col, int rownum, char *buf)
+{
+	static char chars[256][2];
+
+	switch (col->kind)
+	{
+		case COLSTORE_OID:
+			snprintf(buf, COLSTORE_INT_BUFSIZE, "%u",
+					 ((uint32 *) col->values)[rownum]);
+			return buf;
+		case COLSTORE_INT2:
+			snprintf(buf, COLSTORE_INT_BUFSIZE, "%d",
+					 (int) ((int16 *) col->values)[rownum]);
+			return buf;
+		case COLSTORE_INT4:
+			snprintf(buf, COLSTORE_INT_BUFSIZE, "%d",
+					 (int) ((int32 *) col->values)[rownum]);
+			return buf;
+		case COLSTORE_CHAR:
+			{
+				unsigned char c = ((char *) col->values)[rownum];
+
+				chars[c][0] = c;
+				return chars[c];
+			}
+		case COLSTORE_TEXT:
+			break;
+	}
+
+	return cs->pool + ((uint32 *) col->values)[rownum];
+}
+
+/*
+ * Return the offset of a string in the pool, adding it if it's not already
+ * present.
+ */
+static uint32
+intern_string(colstore *cs, const char *value)
+{
+	uint32		mask = cs->intern_size - 1;
+	uint32		i = string_hash_fnv1a(value) & mask;
+	Size		len;
+	uint32		offset;
+
+	while (cs->intern[i] != 0)
+	{
+		if (strcmp(cs->pool + cs->intern[i] - 1, value) == 0)
+			return cs->intern[i] - 1;
+		i = (i + 1) & mask;
+	}
+
+	/* Not found, so add it to the pool. */
+	len = strlen(value) + 1;
+	if (cs->pool_used + len > cs->pool_allocated)
+	{
+		Size		newsize = Max(cs->pool_allocated, 1024);
+
+		while (newsize < cs->pool_used + len)
+			newsize *= 2;
+		if (newsize > PG_UINT32_MAX)
+			pgcc_log(PGCC_FATAL, "out of memory\n");
+		cs->pool = pg_realloc(cs->pool, newsize);
+		cs->pool_allocated = newsize;
+	}
+	offset = cs->pool_used;
+	memcpy(cs->pool + offset, value, len);
+	cs->pool_used += len;
+
+	cs->intern[i] = offset + 1;
+	if (++cs->intern_used > cs->intern_size / 2)
+		intern_grow(cs);
+
+	return offset;
+}
+
+/*
+ * Double the size of the pool's index.
+ */
+static void
+intern_grow(colstore *cs)
+{
+	uint32	   *old = cs->intern;
+	uint32		old_size = cs->intern_size;
+	uint32		mask;
+	uint32		i;
+
+	cs->intern_size = old_size * 2;
+	cs->intern = pg_malloc0(cs->intern_size * sizeof(uint32));
+	mask = cs->intern_size - 1;
+	for (i = 0; i < old_size; i++)
+	{
+		uint32		j;
+
+		if (old[i] == 0)
+			continue;
+		j = string_hash_fnv1a(cs->pool + old[i] - 1) & mask;
+		while (cs->intern[j] != 0)
+			j = (j + 1) & mask;
+		cs->intern[j] = old[i];
+	}
+	pg_free(old);
+}
+
+/*
+ * 32-bit FNV-1a hash of a string.
+ */
+static uint32
+string_hash_fnv1a(const char *s)
+{
+	uint32		hash = 2166136261U;
+
+	while (*s != '\0')
+	{
+		hash ^= (unsigned char) *s++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
@@ -0,0 +1,419 @@
+/*-------------------------------------------------------------------------
+ *
+ * ddllog.c
+ *
+ * Checking only the catalog rows related to recent DDL.  --install-ddl-log
+ * installs a pair of event triggers that record the address of each object
+ * created, altered or dropped in a small table in a schema of its own;
+ * --since-last-run then reads, from each catalog that can be checked a row at
+ * a time, only the rows that refer to a logged object or to something that
+ * depends on one, and after a clean run forgets the entries it has dealt
+ * with.
+ *
+ * The rows to read are chosen by the server, with WHERE clauses built from
+ * the column definitions in definitions.c: a column that refers to a catalog
+ * is compared with the logged objects of that catalog, and a pair of class
+ * and object ID columns with all of them.  Catalogs that other checks refer
+ * to are still read in full, because those checks need their rows; so are
+ * catalogs with table-level checks, and the shared catalogs, since event
+ * triggers don't fire for roles, databases and tablespaces.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include "pqexpbuffer.h"
+
+#include "pg_catcheck.h"
+
+/* pg_event_trigger_ddl_commands() is new in 9.5. */
+#define MINIMUM_DDL_LOG_VERSION		90500
+
+#define DDL_LOG_SCHEMA		"pg_catcheck"
+#define DDL_LOG_TABLE		DDL_LOG_SCHEMA ".ddl_log"
+
+/*
+ * Commands to install the log.
+ *
+ * Event trigger functions otherwise run as whoever issued the DDL, so these
+ * are security definers: anyone's DDL gets logged, but only the installing
+ * superuser can write to the log directly.  That's only safe if nobody else
+ * can have put anything in the schema they write to, such as a table with a
+ * trigger of their own, so we create the schema afresh, and fail if it's
+ * already there.  GRANT, REVOKE and ALTER DEFAULT PRIVILEGES have no object
+ * address, and aren't logged.
+ */
+static const char *install_ddl_log_commands[] = {
+	"CREATE SCHEMA " DDL_LOG_SCHEMA,
+	"CREATE TABLE " DDL_LOG_TABLE " ("
+	" id bigserial PRIMARY KEY,"
+	" classid pg_catalog.oid NOT NULL,"
+	" objid pg_catalog.oid NOT NULL,"
+	" objsubid pg_catalog.int4 NOT NULL,"
+	" dropped pg_catalog.bool NOT NULL,"
+	" logged_at pg_catalog.timestamptz NOT NULL DEFAULT pg_catalog.now())",
+	"CREATE FUNCTION " DDL_LOG_SCHEMA ".log_ddl()"
+	" RETURNS event_trigger LANGUAGE plpgsql"
+	" SECURITY DEFINER SET search_path = pg_catalog, pg_temp AS $$BEGIN"
+	" INSERT INTO " DDL_LOG_TABLE " (classid, objid, objsubid, dropped)"
+	" SELECT classid, objid, objsubid, false"
+	" FROM pg_catalog.pg_event_trigger_ddl_commands()"
+	" WHERE classid IS NOT NULL;"
+	" END$$",
+	"REVOKE ALL ON FUNCTION " DDL_LOG_SCHEMA ".log_ddl() FROM PUBLIC",
+	"CREATE FUNCTION " DDL_LOG_SCHEMA ".log_drop()"
+	" RETURNS event_trigger LANGUAGE plpgsql"
+	" SECURITY DEFINER SET search_path = pg_catalog, pg_temp AS $$BEGIN"
+	" INSERT INTO " DDL_LOG_TABLE " (classid, objid, objsubid, dropped)"
+	" SELECT classid, objid, objsubid, true"
+	" FROM pg_catalog.pg_event_trigger_dropped_objects();"
+	" END$$",
+	"REVOKE ALL ON FUNCTION " DDL_LOG_SCHEMA ".log_drop() FROM PUBLIC",
+	"DROP EVENT TRIGGER IF EXISTS pg_catcheck_log_ddl",
+	"CREATE EVENT TRIGGER pg_catcheck_log_ddl ON ddl_command_end"
+	" EXECUTE PROCEDURE " DDL_LOG_SCHEMA ".log_ddl()",
+	"DROP EVENT TRIGGER IF EXISTS pg_catcheck_log_drop",
+	"CREATE EVENT TRIGGER pg_catcheck_log_drop ON sql_drop"
+	" EXECUTE PROCEDURE " DDL_LOG_SCHEMA ".log_drop()",
+	NULL
+};
+
+/*
+ * Is the log still as we installed it?  Reading it is harmless, but deleting
+ * from it would run any triggers or rules someone had added, so we insist
+ * that it's an ordinary table with neither, owned, like its schema, by a
+ * superuser.  Only the owner, or another superuser, could have changed that.
+ */
+#define DDL_LOG_TRUSTED_QUERY \
+	"SELECT c.relkind = 'r' AND c.relowner = n.nspowner AND r.rolsuper" \
+	" AND NOT EXISTS (SELECT 1 FROM pg_catalog.pg_trigger t" \
+	" WHERE t.tgrelid = c.oid)" \
+	" AND NOT EXISTS (SELECT 1 FROM pg_catalog.pg_rewrite w" \
+	" WHERE w.ev_class = c.oid)" \
+	" FROM pg_catalog.pg_class c" \
+	" JOIN pg_catalog.pg_namespace n ON n.oid = c.relnamespace" \
+	" JOIN pg_catalog.pg_roles r ON r.oid = n.nspowner" \
+	" WHERE n.nspname = '" DDL_LOG_SCHEMA "' AND c.relname = 'ddl_log'"
+
+/*
+ * Catalogs shared by all databases.  Changes to the objects they describe
+ * aren't logged, so they, and catalogs that refer to them, can't be checked
+ * this way.
+ */
+static char *shared_catalogs[] = {
+	"pg_authid",
+	"pg_auth_members",
+	"pg_database",
+	"pg_db_role_setting",
+	"pg_parameter_acl",
+	"pg_replication_origin",
+	"pg_shdepend",
+	"pg_shdescription",
+	"pg_shseclabel",
+	"pg_subscription",
+	"pg_tablespace",
+	"edb_last_ddl_time_shared",
+	NULL
+};
+
+static bool have_ddl_log = false;
+static char *logged_ids;		/* array of the entries to deal with */
+static long nlogged;			/* # of entries in it */
+
+static bool is_shared_catalog(char *table_name);
+static void append_affected_objects(PQExpBuffer buf);
+
+/*
+ * Install the DDL log and its event triggers.  This needs superuser
+ * privileges, since event triggers do.
+ */
+void
+install_ddl_log(PGconn *conn)
+{
+	PGresult   *res;
+	const char **command;
+
+	if (remote_version < MINIMUM_DDL_LOG_VERSION)
+		pgcc_log(PGCC_FATAL,
+				 "server version (%d) does not support logging DDL commands (%d required)\n",
+				 remote_version, MINIMUM_DDL_LOG_VERSION);
+
+	res = PQexec(conn, "BEGIN");
+	PQclear(res);
+	for (command = install_ddl_log_commands; *command != NULL; ++command)
+	{
+		pgcc_log(PGCC_DEBUG, "executing query: %s\n", *command);
+		res = PQexec(conn, *command);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			pgcc_log(PGCC_FATAL, "could not install DDL log: %s",
+					 PQresultErrorMessage(res));
+		PQclear(res);
+	}
+	res = PQexec(conn, "COMMIT");
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgcc_log(PGCC_FATAL, "could not install DDL log: %s",
+				 PQresultErrorMessage(res));
+	PQclear(res);
+
+	pgcc_log(PGCC_PROGRESS, "installed DDL log in table %s\n",
+			 DDL_LOG_TABLE);
+}
+
+/*
+ * Find out how much DDL there is to deal with.  Entries we can't see yet are
+ * left for the next run.  Ids are assigned when rows are inserted, not when
+ * they're committed, so an entry that becomes visible later may have a lower
+ * id than one we can see; we remember exactly which ids we saw.  If there's
+ * no log, or it isn't as we installed it, we check every row.
+ */
+void
+begin_ddl_log_check(PGconn *conn)
+{
+	PGresult   *res;
+
+	res = PQexec(conn, DDL_LOG_TRUSTED_QUERY);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		pgcc_log(PGCC_WARNING,
+				 "could not read DDL log; checking all rows: %s",
+				 PQresultErrorMessage(res));
+		PQclear(res);
+		return;
+	}
+	if (PQntuples(res) != 1)
+	{
+		pgcc_log(PGCC_WARNING,
+				 "DDL log %s does not exist; checking all rows\n",
+				 DDL_LOG_TABLE);
+		PQclear(res);
+		return;
+	}
+	if (strcmp(PQgetvalue(res, 0, 0), "t") != 0)
+	{
+		pgcc_log(PGCC_ERROR,
+				 "DDL log %s has been altered since it was installed; checking all rows\n",
+				 DDL_LOG_TABLE);
+		PQclear(res);
+		return;
+	}
+	PQclear(res);
+
+	res = PQexec(conn,
+				 "SELECT pg_catalog.count(*),"
+				 " pg_catalog.coalesce(pg_catalog.array_agg(id ORDER BY id), '{}')"
+				 " FROM " DDL_LOG_TABLE);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+	{
+		pgcc_log(PGCC_WARNING,
+				 "could not read DDL log; checking all rows: %s",
+				 PQresultErrorMessage(res));
+		PQclear(res);
+		return;
+	}
+	nlogged = atol(PQgetvalue(res, 0, 0));
+	logged_ids = pg_strdup(PQgetvalue(res, 0, 1));
+	have_ddl_log = true;
+	PQclear(res);
+
+	pgcc_log(PGCC_VERBOSE, "found %ld DDL log entries\n", nlogged);
+}
+
+/*
+ * Can we read just the rows of this table related to logged DDL?
+ */
+bool
+table_uses_ddl_log(pg_catalog_table *tab)
+{
+	pg_catalog_column *tabcol;
+
+	if (!have_ddl_log || is_shared_catalog(tab->table_name) ||
+		!table_checks_only_references(tab))
+		return false;
+
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+	{
+		pg_catalog_check_oid *check = tabcol->check;
+
+		if (tabcol->checked != TRI_YES || check == NULL)
+			continue;
+		if ((check->type == CHECK_OID_REFERENCE ||
+			 check->type == CHECK_OID_VECTOR_REFERENCE ||
+			 check->type == CHECK_OID_ARRAY_REFERENCE) &&
+			is_shared_catalog(check->oid_references_table))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Build a WHERE clause for a table's query, selecting the rows that refer to
+ * a logged object, or to an object that depends on one, or that describe one
+ * themselves.
+ */
+char *
+build_ddl_log_filter(pg_catalog_table *tab)
+{
+	PQExpBuffer query = createPQExpBuffer();
+	pg_catalog_column *tabcol;
+	char	   *result;
+
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+	{
+		pg_catalog_check_oid *check = tabcol->check;
+		pg_catalog_column *objcol = tabcol;
+		char	   *reftable = NULL;
+		bool		is_array = false;
+
+		if (!tabcol->available)
+			continue;
+
+		/* A key OID identifies one of this catalog's own objects. */
+		if (tabcol->is_key_column && strcmp(tabcol->name, "oid") == 0)
+			reftable = tab->table_name;
+		else if (tabcol->checked != TRI_YES || check == NULL)
+			continue;
+		else if (check->type == CHECK_OID_REFERENCE ||
+				 check->type == CHECK_OID_VECTOR_REFERENCE ||
+				 check->type == CHECK_OID_ARRAY_REFERENCE)
+		{
+			reftable = check->oid_references_table;
+			is_array = check->type != CHECK_OID_REFERENCE;
+		}
+		else if (check->type == CHECK_DEPENDENCY_SUBID)
+		{
+			/*
+			 * A sub-ID refers to a column of the object its object ID refers
+			 * to, and dropping a column logs that object with the column's
+			 * sub-ID, so look at the object ID, unless we already are.
+			 */
+			objcol = find_dependency_object_column(tab, tabcol);
+			if (objcol->checked == TRI_YES)
+				continue;
+		}
+		else if (check->type != CHECK_DEPENDENCY_ID)
+			continue;
+
+		appendPQExpBufferStr(query, query->len > 0 ? " OR " : "");
+		if (reftable == NULL)
+		{
+			/* A class and object ID can refer to any object. */
+			appendPQExpBuffer(query, "(%s, %s) IN (SELECT classid, objid FROM (",
+							  find_dependency_class_column(tab, tabcol)->name,
+							  objcol->name);
+			append_affected_objects(query);
+			appendPQExpBufferStr(query, ") a)");
+			continue;
+		}
+
+		if (is_array)
+			appendPQExpBuffer(query, "%s::pg_catalog.oid[] OPERATOR(pg_catalog.&&) ARRAY(",
+							  tabcol->name);
+		else if (tabcol->cast != NULL)
+			appendPQExpBuffer(query, "%s::%s IN (", tabcol->name,
+							  tabcol->cast);
+		else
+			appendPQExpBuffer(query, "%s IN (", tabcol->name);
+		appendPQExpBufferStr(query, "SELECT objid FROM (");
+		append_affected_objects(query);
+		appendPQExpBuffer(query,
+						  ") a WHERE classid = 'pg_catalog.%s'::pg_catalog.regclass)",
+						  reftable);
+	}
+
+	/* If we don't know what to look for, there's nothing to read. */
+	if (query->len == 0)
+		appendPQExpBufferStr(query, "false");
+
+	result = pg_strdup(query->data);
+	destroyPQExpBuffer(query);
+
+	return result;
+}
+
+/*
+ * Add a query for the objects affected by logged DDL: the logged objects
+ * themselves, and whatever depends on them directly, which may have been
+ * changed along with them.
+ */
+static void
+append_affected_objects(PQExpBuffer buf)
+{
+	appendPQExpBuffer(buf,
+					  "SELECT classid, objid FROM " DDL_LOG_TABLE
+					  " WHERE id = ANY ('%s'::pg_catalog.int8[])"
+					  " UNION SELECT d.classid, d.objid"
+					  " FROM pg_catalog.pg_depend d, " DDL_LOG_TABLE " l"
+					  " WHERE l.id = ANY ('%s'::pg_catalog.int8[])"
+					  " AND d.refclassid = l.classid AND d.refobjid = l.objid",
+					  logged_ids, logged_ids);
+}
+
+/*
+ * Forget the log entries this run dealt with, if it went cleanly.  If it
+ * found inconsistencies, we keep them, so that the rows involved will be
+ * checked again next time.
+ */
+void
+finish_ddl_log_check(PGconn *conn)
+{
+	pg_catalog_table *tab;
+	int			ntables = 0;
+	long		nrows = 0;
+	PQExpBuffer query;
+	PGresult   *res;
+
+	if (!have_ddl_log)
+		return;
+
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+	{
+		if (!tab->incremental)
+			continue;
+		pgcc_log(PGCC_VERBOSE,
+				 "checked %ld rows of table %s related to logged DDL\n",
+				 tab->rows_checked, tab->table_name);
+		ntables++;
+		nrows += tab->rows_checked;
+	}
+	if (ntables > 0)
+		pgcc_log(PGCC_PROGRESS,
+				 "checked only rows related to %ld logged DDL commands in %d tables (%ld rows)\n",
+				 nlogged, ntables, nrows);
+
+	if (pgcc_log_had_errors() || pgcc_log_had_inconsistencies())
+	{
+		pgcc_log(PGCC_PROGRESS,
+				 "keeping DDL log entries for the next run\n");
+		return;
+	}
+
+	query = createPQExpBuffer();
+	appendPQExpBuffer(query,
+					  "DELETE FROM " DDL_LOG_TABLE
+					  " WHERE id = ANY ('%s'::pg_catalog.int8[])",
+					  logged_ids);
+	pgcc_log(PGCC_DEBUG, "executing query: %s\n", query->data);
+	res = PQexec(conn, query->data);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgcc_log(PGCC_ERROR, "could not clear DDL log: %s",
+				 PQresultErrorMessage(res));
+	PQclear(res);
+	destroyPQExpBuffer(query);
+}
+
+/*
+ * Is this one of the catalogs shared by all databases?
+ */
+static bool
+is_shared_catalog(char *table_name)
+{
+	char	  **name;
+
+	for (name = shared_catalogs; *name != NULL; ++name)
+		if (strcmp(*name, table_name) == 0)
+			return true;
+
+	return false;
+}
@@ -16,6 +16,13 @@
  * building a hash table to allow lookups into that table by key unless
  * we require the ability to perform suchh lookups.
  *
+ * A few checks look at whole rows rather than at any one column, such as
+ * the check for objects with more than one owner in pg_shdepend, the checks
+ * of pg_depend as a whole graph, or the checks that unique keys other than
+ * the one we hash a table on, such as the names of relations within each
+ * namespace, have no duplicates.  These are attached to the table rather
+ * than to a column.
+ *
  *-------------------------------------------------------------------------
  */
 
@@ -29,6 +36,8 @@ static struct pg_catalog_check_oid check_am_optional_oid =
 {CHECK_OID_REFERENCE, true, "pg_am"};
 static struct pg_catalog_check_oid check_attnum_value =
 {CHECK_ATTNUM};
+static struct pg_catalog_check_unique check_attribute_name_unique =
+{CHECK_UNIQUE_KEY, 0, {"attrelid", "attname"}};
 static struct pg_catalog_check_oid check_authid_oid =
 {CHECK_OID_REFERENCE, false, "pg_authid"};
 static struct pg_catalog_check_oid check_authid_oid_array_zero_ok =
@@ -41,8 +50,12 @@ static struct pg_catalog_check_oid check_class_oid_array =
 {CHECK_OID_ARRAY_REFERENCE, false, "pg_class"};
 static struct pg_catalog_check_oid check_class_optional_oid =
 {CHECK_OID_REFERENCE, true, "pg_class"};
+static struct pg_catalog_check_unique check_class_name_unique =
+{CHECK_UNIQUE_KEY, 0, {"relname", "relnamespace"}};
 static struct pg_catalog_check_oid check_constraint_oid =
 {CHECK_OID_REFERENCE, false, "pg_constraint"};
+static struct pg_catalog_check_unique check_constraint_name_unique =
+{CHECK_UNIQUE_KEY, 120000, {"conrelid", "contypid", "conname"}};
 static struct pg_catalog_check_oid check_collation_optional_oid =
 {CHECK_OID_REFERENCE, true, "pg_collation"};
 static struct pg_catalog_check_oid check_collation_optional_oid_vector =
@@ -51,12 +64,16 @@ static struct pg_catalog_check_oid check_constraint_optional_oid =
 {CHECK_OID_REFERENCE, true, "pg_constraint"};
 static struct pg_catalog_check_oid check_database_optional_oid =
 {CHECK_OID_REFERENCE, true, "pg_database"};
+static struct pg_catalog_check check_dependency_graph_value =
+{CHECK_DEPENDENCY_GRAPH};
 static struct pg_catalog_check check_dependency_id_value =
 {CHECK_DEPENDENCY_ID};
 static struct pg_catalog_check check_dependency_class_id_value =
 {CHECK_DEPENDENCY_CLASS_ID};
 static struct pg_catalog_check check_dependency_subid_value =
 {CHECK_DEPENDENCY_SUBID};
+static struct pg_catalog_check check_duplicate_owner_value =
+{CHECK_DUPLICATE_OWNER};
 static struct pg_catalog_check_oid check_edb_partdef =
 {CHECK_OID_REFERENCE, false, "edb_partdef"};
 static struct pg_catalog_check_oid check_edb_partition_optional_oid =
@@ -77,6 +94,8 @@ static struct pg_catalog_check_oid check_namespace_oid =
 {CHECK_OID_REFERENCE, false, "pg_namespace"};
 static struct pg_catalog_check_oid check_namespace_optional_oid =
 {CHECK_OID_REFERENCE, true, "pg_namespace"};
+static struct pg_catalog_check_unique check_namespace_name_unique =
+{CHECK_UNIQUE_KEY, 0, {"nspname", "nspparent"}};
 static struct pg_catalog_check_oid check_opclass_oid =
 {CHECK_OID_REFERENCE, false, "pg_opclass"};
 static struct pg_catalog_check_oid check_opclass_oid_vector =
@@ -119,6 +138,8 @@ static struct pg_catalog_check_oid check_type_oid_vector =
 {CHECK_OID_VECTOR_REFERENCE, false, "pg_type"};
 static struct pg_catalog_check_oid check_type_optional_oid =
 {CHECK_OID_REFERENCE, true, "pg_type"};
+static struct pg_catalog_check_unique check_type_name_unique =
+{CHECK_UNIQUE_KEY, 0, {"typname", "typnamespace"}};
 static struct pg_catalog_check_oid check_queue_oid =
 {CHECK_OID_REFERENCE, false, "edb_queue"};
 static struct pg_catalog_check_oid check_publication_oid =
@@ -933,17 +954,17 @@ static struct pg_catalog_column edb_last_ddl_time_shared_column[] =
 
 struct pg_catalog_table pg_catalog_tables[] =
 {
-	{"pg_class", pg_class_column},
-	{"pg_namespace", pg_namespace_column},
+	{"pg_class", pg_class_column, &check_class_name_unique},
+	{"pg_namespace", pg_namespace_column, &check_namespace_name_unique},
 	{"pg_authid", pg_authid_column},
 	{"pg_tablespace", pg_tablespace_column},
-	{"pg_type", pg_type_column},
+	{"pg_type", pg_type_column, &check_type_name_unique},
 	{"pg_am", pg_am_column},
 	{"pg_collation", pg_collation_column},
 	{"pg_proc", pg_proc_column},
 	{"pg_language", pg_language_column},
 	{"pg_index", pg_index_column},
-	{"pg_constraint", pg_constraint_column},
+	{"pg_constraint", pg_constraint_column, &check_constraint_name_unique},
 	{"pg_database", pg_database_column},
 	{"pg_cast", pg_cast_column},
 	{"pg_conversion", pg_conversion_column},
@@ -973,11 +994,11 @@ struct pg_catalog_table pg_catalog_tables[] =
 	{"pg_ts_config_map", pg_ts_config_map_column},
 	{"pg_range", pg_range_column},
 	{"pg_attrdef", pg_attrdef_column},
-	{"pg_attribute", pg_attribute_column},
+	{"pg_attribute", pg_attribute_column, &check_attribute_name_unique},
 	{"pg_statistic", pg_statistic_column},
 	{"pg_db_role_setting", pg_db_role_setting_column},
-	{"pg_depend", pg_depend_column},
-	{"pg_shdepend", pg_shdepend_column},
+	{"pg_depend", pg_depend_column, &check_dependency_graph_value},
+	{"pg_shdepend", pg_shdepend_column, &check_duplicate_owner_value},
 	{"edb_dir", edb_dir_column},
 	{"edb_partdef", edb_partdef_column},
 	{"edb_partition", edb_partition_column},
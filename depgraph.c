@@ -0,0 +1,464 @@
+/*-------------------------------------------------------------------------
+ *
+ * depgraph.c
+ *
+ * Directed graph over object addresses, for checks that have to look at
+ * the dependency catalogs as a whole rather than a row at a time.
+ *
+ * Edges are added one at a time, each with a one-byte label (the dependency
+ * type) and an identifier (the row it came from).  Once all edges are in,
+ * depgraph_finish() converts the graph to compressed sparse row form: the
+ * edges are sorted by source node, so that a node's successors are a
+ * contiguous run of the target array, found from an array of offsets.
+ * That costs 9 bytes per edge plus 12 per node, and every traversal is a
+ * sequential scan of that run.
+ *
+ * The traversals take a string of the edge labels to follow, so one graph
+ * can answer questions about different kinds of dependencies.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include "pg_catcheck.h"
+
+struct depgraph
+{
+	/* Nodes, numbered in order of first appearance. */
+	int			nnodes;
+	int			nnodes_allocated;
+	int		   *node_classno;
+	Oid		   *node_objid;
+	objaddr_index *node_index;	/* address to node number; NULL once built */
+
+	/* Edges: sources only until depgraph_finish(), then offsets instead. */
+	int			nedges;
+	int			nedges_allocated;
+	int		   *edge_source;
+	int		   *edge_target;
+	char	   *edge_label;
+	int		   *edge_id;
+	int		   *offsets;		/* nnodes + 1 entries, once finished */
+};
+
+static int	depgraph_node(depgraph *graph, int classno, Oid objid);
+static void label_filter(const char *labels, bool *follow);
+
+/*
+ * Create an empty graph, sized for the given number of edges.
+ */
+depgraph *
+depgraph_create(int expected_edges)
+{
+	depgraph   *graph = pg_malloc0(sizeof(depgraph));
+
+	graph->nedges_allocated = Max(expected_edges, 16);
+	graph->edge_source = pg_malloc(graph->nedges_allocated * sizeof(int));
+	graph->edge_target = pg_malloc(graph->nedges_allocated * sizeof(int));
+	graph->edge_label = pg_malloc(graph->nedges_allocated * sizeof(char));
+	graph->edge_id = pg_malloc(graph->nedges_allocated * sizeof(int));
+
+	graph->nnodes_allocated = 16;
+	graph->node_classno = pg_malloc(graph->nnodes_allocated * sizeof(int));
+	graph->node_objid = pg_malloc(graph->nnodes_allocated * sizeof(Oid));
+	graph->node_index = objaddr_index_create(expected_edges);
+
+	return graph;
+}
+
+/*
+ * Add an edge from one object to another.  Objects are identified as in an
+ * objaddr_index, by a class number of the caller's choosing and an OID.
+ */
+void
+depgraph_add_edge(depgraph *graph, int source_classno, Oid source_objid,
+				  int target_classno, Oid target_objid, char label, int id)
+{
+	int			i;
+
+	Assert(graph->offsets == NULL);
+
+	if (graph->nedges >= graph->nedges_allocated)
+	{
+		graph->nedges_allocated *= 2;
+		graph->edge_source = pg_realloc(graph->edge_source,
+										graph->nedges_allocated * sizeof(int));
+		graph->edge_target = pg_realloc(graph->edge_target,
+										graph->nedges_allocated * sizeof(int));
+		graph->edge_label = pg_realloc(graph->edge_label,
+									   graph->nedges_allocated * sizeof(char));
+		graph->edge_id = pg_realloc(graph->edge_id,
+									graph->nedges_allocated * sizeof(int));
+	}
+
+	i = graph->nedges++;
+	graph->edge_source[i] = depgraph_node(graph, source_classno, source_objid);
+	graph->edge_target[i] = depgraph_node(graph, target_classno, target_objid);
+	graph->edge_label[i] = label;
+	graph->edge_id[i] = id;
+}
+
+/*
+ * Convert the graph to compressed sparse row form.  No more edges can be
+ * added afterwards.
+ *
+ * This is a counting sort of the edges by source node, which keeps the
+ * edges of each node in the order they were added.
+ */
+void
+depgraph_finish(depgraph *graph)
+{
+	int		   *offsets;
+	int		   *target;
+	char	   *label;
+	int		   *id;
+	int			i;
+
+	offsets = pg_malloc0((graph->nnodes + 1) * sizeof(int));
+	for (i = 0; i < graph->nedges; i++)
+		offsets[graph->edge_source[i] + 1]++;
+	for (i = 0; i < graph->nnodes; i++)
+		offsets[i + 1] += offsets[i];
+
+	target = pg_malloc(Max(graph->nedges, 1) * sizeof(int));
+	label = pg_malloc(Max(graph->nedges, 1) * sizeof(char));
+	id = pg_malloc(Max(graph->nedges, 1) * sizeof(int));
+
+	/* Place each edge, using the source array to track the next slot. */
+	for (i = 0; i < graph->nedges; i++)
+	{
+		int			pos = offsets[graph->edge_source[i]]++;
+
+		target[pos] = graph->edge_target[i];
+		label[pos] = graph->edge_label[i];
+		id[pos] = graph->edge_id[i];
+	}
+
+	/* That advanced each offset to the start of the next node; put back. */
+	for (i = graph->nnodes; i > 0; i--)
+		offsets[i] = offsets[i - 1];
+	offsets[0] = 0;
+
+	pg_free(graph->edge_source);
+	pg_free(graph->edge_target);
+	pg_free(graph->edge_label);
+	pg_free(graph->edge_id);
+	graph->edge_source = NULL;
+	graph->edge_target = target;
+	graph->edge_label = label;
+	graph->edge_id = id;
+	graph->offsets = offsets;
+
+	/* The address index was only needed to number the nodes. */
+	objaddr_index_destroy(graph->node_index);
+	graph->node_index = NULL;
+}
+
+/*
+ * Free a graph.
+ */
+void
+depgraph_destroy(depgraph *graph)
+{
+	if (graph->node_index != NULL)
+		objaddr_index_destroy(graph->node_index);
+	if (graph->edge_source != NULL)
+		pg_free(graph->edge_source);
+	if (graph->offsets != NULL)
+		pg_free(graph->offsets);
+	pg_free(graph->edge_target);
+	pg_free(graph->edge_label);
+	pg_free(graph->edge_id);
+	pg_free(graph->node_classno);
+	pg_free(graph->node_objid);
+	pg_free(graph);
+}
+
+/*
+ * Number of nodes in the graph.
+ */
+int
+depgraph_nnodes(depgraph *graph)
+{
+	return graph->nnodes;
+}
+
+/*
+ * Get the address of a node.
+ */
+void
+depgraph_node_address(depgraph *graph, int node, int *classno, Oid *objid)
+{
+	*classno = graph->node_classno[node];
+	*objid = graph->node_objid[node];
+}
+
+/*
+ * Get the edges leaving a node, in a finished graph.  The return value is
+ * the number of edges; the arrays of their targets, labels and identifiers
+ * are returned through the other arguments.
+ */
+int
+depgraph_edges(depgraph *graph, int node, int **target, char **label,
+			   int **id)
+{
+	int			start = graph->offsets[node];
+
+	*target = &graph->edge_target[start];
+	*label = &graph->edge_label[start];
+	*id = &graph->edge_id[start];
+	return graph->offsets[node + 1] - start;
+}
+
+/*
+ * Bytes of memory used by a finished graph.
+ */
+Size
+depgraph_memory(depgraph *graph)
+{
+	return sizeof(depgraph) +
+		(Size) graph->nnodes * (sizeof(int) * 2 + sizeof(Oid)) +
+		(Size) graph->nedges * (sizeof(int) * 2 + sizeof(char));
+}
+
+/*
+ * Find the strongly connected components of the subgraph made up of edges
+ * with the given labels, using Tarjan's algorithm.  The result is an array
+ * giving the component number of each node; *component_size, if not NULL,
+ * is set to an array giving the number of nodes in each component.
+ *
+ * Components are numbered in the order in which they're completed, so an
+ * edge between two different components always leads to the one with the
+ * lower number.
+ *
+ * The depth-first search is iterative, keeping its own stack of nodes and
+ * the position reached in each node's edges, since dependency chains can be
+ * far deeper than the C stack allows for.
+ */
+int *
+depgraph_components(depgraph *graph, const char *labels, int **component_size)
+{
+	int			nnodes = graph->nnodes;
+	int		   *component = pg_malloc(Max(nnodes, 1) * sizeof(int));
+	int		   *size = NULL;
+	int		   *index = pg_malloc(Max(nnodes, 1) * sizeof(int));
+	int		   *lowlink = pg_malloc(Max(nnodes, 1) * sizeof(int));
+	int		   *stack = pg_malloc(Max(nnodes, 1) * sizeof(int));
+	int		   *call_node = pg_malloc(Max(nnodes, 1) * sizeof(int));
+	int		   *call_edge = pg_malloc(Max(nnodes, 1) * sizeof(int));
+	bool		follow[256];
+	int			nstack = 0;
+	int			next_index = 0;
+	int			ncomponents = 0;
+	int			root;
+	int			i;
+
+	Assert(graph->offsets != NULL);
+	label_filter(labels, follow);
+
+	/* index[] is -1 for unvisited nodes; component[] -1 until assigned. */
+	for (i = 0; i < nnodes; i++)
+	{
+		index[i] = -1;
+		component[i] = -1;
+	}
+
+	for (root = 0; root < nnodes; root++)
+	{
+		int			depth;
+
+		if (index[root] != -1)
+			continue;
+
+		/* Visit the root. */
+		depth = 0;
+		call_node[0] = root;
+		call_edge[0] = graph->offsets[root];
+		index[root] = lowlink[root] = next_index++;
+		stack[nstack++] = root;
+
+		while (depth >= 0)
+		{
+			int			v = call_node[depth];
+			int			e = call_edge[depth];
+
+			if (e < graph->offsets[v + 1])
+			{
+				int			w = graph->edge_target[e];
+
+				call_edge[depth]++;
+				if (!follow[(unsigned char) graph->edge_label[e]])
+					continue;
+
+				if (index[w] == -1)
+				{
+					/* Descend into w. */
+					depth++;
+					call_node[depth] = w;
+					call_edge[depth] = graph->offsets[w];
+					index[w] = lowlink[w] = next_index++;
+					stack[nstack++] = w;
+				}
+				else if (component[w] == -1)
+				{
+					/* w is on the stack, so it's in the current component. */
+					lowlink[v] = Min(lowlink[v], index[w]);
+				}
+				continue;
+			}
+
+			/* All of v's edges are done.  Is it the root of a component? */
+			if (lowlink[v] == index[v])
+			{
+				int			w;
+
+				do
+				{
+					w = stack[--nstack];
+					component[w] = ncomponents;
+				} while (w != v);
+				ncomponents++;
+			}
+
+			/* Return to the caller, and pass our lowlink up. */
+			depth--;
+			if (depth >= 0)
+			{
+				int			u = call_node[depth];
+
+				lowlink[u] = Min(lowlink[u], lowlink[v]);
+			}
+		}
+	}
+
+	if (component_size != NULL)
+	{
+		size = pg_malloc0(Max(ncomponents, 1) * sizeof(int));
+		for (i = 0; i < nnodes; i++)
+			size[component[i]]++;
+		*component_size = size;
+	}
+
+	pg_free(index);
+	pg_free(lowlink);
+	pg_free(stack);
+	pg_free(call_node);
+	pg_free(call_edge);
+
+	return component;
+}
+
+/*
+ * Find every node from which one of the given nodes can be reached by
+ * following edges with the given labels.  The given nodes are included.
+ *
+ * We build the transpose of the selected edges and search it breadth-first
+ * from all the given nodes at once, so each edge is examined at most twice.
+ */
+bool *
+depgraph_reaching(depgraph *graph, const char *labels, const bool *targets)
+{
+	int			nnodes = graph->nnodes;
+	bool	   *result = pg_malloc0(Max(nnodes, 1) * sizeof(bool));
+	int		   *roffsets = pg_malloc0((nnodes + 1) * sizeof(int));
+	int		   *rsource;
+	int		   *queue;
+	int			head = 0;
+	int			tail = 0;
+	bool		follow[256];
+	int			v;
+	int			e;
+
+	Assert(graph->offsets != NULL);
+	label_filter(labels, follow);
+
+	/* Build the transpose of the selected edges. */
+	for (e = 0; e < graph->nedges; e++)
+		if (follow[(unsigned char) graph->edge_label[e]])
+			roffsets[graph->edge_target[e] + 1]++;
+	for (v = 0; v < nnodes; v++)
+		roffsets[v + 1] += roffsets[v];
+	rsource = pg_malloc(Max(roffsets[nnodes], 1) * sizeof(int));
+	for (v = 0; v < nnodes; v++)
+	{
+		for (e = graph->offsets[v]; e < graph->offsets[v + 1]; e++)
+			if (follow[(unsigned char) graph->edge_label[e]])
+				rsource[roffsets[graph->edge_target[e]]++] = v;
+	}
+	for (v = nnodes; v > 0; v--)
+		roffsets[v] = roffsets[v - 1];
+	roffsets[0] = 0;
+
+	/* Search backwards from the targets. */
+	queue = pg_malloc(Max(nnodes, 1) * sizeof(int));
+	for (v = 0; v < nnodes; v++)
+	{
+		if (targets[v])
+		{
+			result[v] = true;
+			queue[tail++] = v;
+		}
+	}
+	while (head < tail)
+	{
+		int			w = queue[head++];
+
+		for (e = roffsets[w]; e < roffsets[w + 1]; e++)
+		{
+			int			u = rsource[e];
+
+			if (!result[u])
+			{
+				result[u] = true;
+				queue[tail++] = u;
+			}
+		}
+	}
+
+	pg_free(roffsets);
+	pg_free(rsource);
+	pg_free(queue);
+
+	return result;
+}
+
+/*
+ * Find or create the node for an object.
+ */
+static int
+depgraph_node(depgraph *graph, int classno, Oid objid)
+{
+	int			node;
+
+	node = objaddr_index_insert(graph->node_index, classno, objid,
+								graph->nnodes);
+	if (node != -1)
+		return node;
+
+	if (graph->nnodes >= graph->nnodes_allocated)
+	{
+		graph->nnodes_allocated *= 2;
+		graph->node_classno = pg_realloc(graph->node_classno,
+										 graph->nnodes_allocated *
+										 sizeof(int));
+		graph->node_objid = pg_realloc(graph->node_objid,
+									   graph->nnodes_allocated *
+									   sizeof(Oid));
+	}
+	graph->node_classno[graph->nnodes] = classno;
+	graph->node_objid[graph->nnodes] = objid;
+
+	return graph->nnodes++;
+}
+
+/*
+ * Convert a string of edge labels to a lookup table.
+ */
+static void
+label_filter(const char *labels, bool *follow)
+{
+	memset(follow, 0, 256 * sizeof(bool));
+	for (; *labels != '\0'; labels++)
+		follow[(unsigned char) *labels] = true;
+}
@@ -0,0 +1,968 @@
+/*-------------------------------------------------------------------------
+ *
+ * incremental.c
+ *
+ * Incremental checking.  With --incremental=STATEFILE, we remember enough
+ * about each run to check, next time, only the rows of unreferenced catalogs
+ * that might have changed in the meantime.
+ *
+ * At the start of each run, we note the xmin horizon of a fresh snapshot:
+ * every transaction older than that had finished, so every row inserted or
+ * updated before it was visible to this run and got checked.  Next time, a
+ * row whose xmin is no older than that horizon may be new, and gets checked;
+ * any other row is exactly as it was last time, and can only have become
+ * invalid if something it refers to has gone away.  To find out what went
+ * away, we save the key OIDs of each catalog that we read in full, and
+ * compare them with the keys found next time; rows referring to a deleted
+ * key are checked again as well.  Sub-IDs refer to pg_attribute, so we save
+ * its (attrelid, attnum) keys too, and check again the rows referring to a
+ * relation that has lost an attribute.  So are rows we complained about last
+ * time, identified by ctid, so that problems don't go unreported just
+ * because nobody has touched the row since.  VACUUM FULL and CLUSTER move
+ * rows without changing their xmin, so those ctids only mean anything if the
+ * table hasn't been rewritten; we save each table's relfilenode, and read the
+ * table in full if that has changed.
+ *
+ * Only catalogs that nothing refers to, like pg_depend or pg_description,
+ * can be checked this way, and only if every check of their columns just
+ * looks for the objects they refer to.  Catalogs that other checks refer to
+ * are still read in full, because those checks need their rows, not just
+ * their keys.  A catalog with a table-level check, such as the graph check
+ * of pg_depend, is also read in full, since the check needs every row; it
+ * can be checked incrementally if only particular columns are selected.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include "pqexpbuffer.h"
+
+#include "pg_catcheck.h"
+
+#define STATE_FILE_HEADER		"pg_catcheck-incremental-state"
+#define STATE_FILE_VERSION		2
+
+/*
+ * If this many keys have been deleted, or rows reported, it's cheaper to
+ * read the whole table than to send a list of them.
+ */
+#define MAX_INCREMENTAL_KEYS	100000
+
+/*
+ * A pg_attribute key is saved as attrelid shifted left this far, plus attnum
+ * as an unsigned 16-bit number.
+ */
+#define ATTRIBUTE_KEY_SHIFT		16
+
+/*
+ * A saved xmin horizon older than this many transactions can't be compared
+ * with xmin any more; see build_incremental_filter().
+ */
+#define MAX_HORIZON_AGE			((uint64) 1 << 30)
+
+typedef struct table_state
+{
+	/* What the previous run saved. */
+	bool		was_checked;	/* was the table checked? */
+	char	   *checked_columns;	/* ... and which columns? */
+	uint32		old_relfilenode;	/* ... and where were its rows? */
+	bool		have_old_keys;	/* did it save the table's keys? */
+	int			nold_keys;
+	uint64	   *old_keys;		/* sorted */
+	int			nold_reported;
+	char	  **old_reported;	/* ctids of rows with reports */
+
+	/* What this run has found so far. */
+	uint32		relfilenode;	/* 0 if unknown */
+	bool		have_keys;		/* have we read all the table's keys? */
+	int			nkeys;
+	uint64	   *keys;			/* sorted */
+	bool		have_deleted;	/* do we know which keys went away? */
+	int			ndeleted;
+	uint32	   *deleted;		/* sorted; for pg_attribute, relation OIDs */
+	int			nreported;
+	int			nreported_allocated;
+	char	  **reported;		/* ctids of rows with reports */
+} table_state;
+
+static char *state_path = NULL;
+static table_state *states;		/* indexed like pg_catalog_tables */
+static bool have_horizon = false;
+static uint64 horizon;			/* this run's horizon */
+static bool have_previous = false;
+static uint64 previous_horizon;
+
+static void fetch_relfilenodes(PGconn *conn);
+static bool read_state_file(FILE *f);
+static uint64 *read_oid_keys(pg_catalog_table *tab, int *nkeys);
+static uint64 *read_attribute_keys(pg_catalog_table *tab, int *nkeys);
+static bool read_keys(FILE *f, int n, uint64 **keys);
+static void write_state_file(void);
+static char *checked_columns(pg_catalog_table *tab);
+static bool table_key_is_oid(pg_catalog_table *tab);
+static table_state *referenced_state(pg_catalog_check *check);
+static bool all_deletions_known(int *ndeleted);
+static void append_any(PQExpBuffer query, char *column, char *cast,
+		   int ntables, table_state **with_deleted);
+
+/*
+ * Start an incremental run: note the xmin horizon, and read what the previous
+ * run saved, if it applies to this database.  Call once we know the server
+ * version and database OID, and which checks we're going to run.
+ */
+void
+begin_incremental_check(PGconn *conn, char *path)
+{
+	PGresult   *res;
+	FILE	   *f;
+	int			ntables = 0;
+	pg_catalog_table *tab;
+
+	state_path = path;
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+		ntables++;
+	states = pg_malloc0(ntables * sizeof(table_state));
+
+	res = PQexec(conn,
+				 "SELECT pg_catalog.txid_snapshot_xmin(pg_catalog.txid_current_snapshot())");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+	{
+		pgcc_log(PGCC_WARNING,
+				 "could not determine transaction horizon; checking all rows: %s",
+				 PQresultErrorMessage(res));
+		PQclear(res);
+		return;
+	}
+	horizon = strtoull(PQgetvalue(res, 0, 0), NULL, 10);
+	have_horizon = true;
+	PQclear(res);
+	pgcc_log(PGCC_DEBUG, "transaction horizon is " UINT64_FORMAT "\n",
+			 horizon);
+	fetch_relfilenodes(conn);
+
+	f = fopen(state_path, "r");
+	if (f == NULL)
+	{
+		if (errno != ENOENT)
+			pgcc_log(PGCC_WARNING, "could not open state file \"%s\": %s\n",
+					 state_path, strerror(errno));
+		else
+			pgcc_log(PGCC_VERBOSE,
+					 "no state file \"%s\"; checking all rows\n",
+					 state_path);
+		return;
+	}
+	have_previous = read_state_file(f);
+	fclose(f);
+	if (!have_previous)
+		return;
+
+	/*
+	 * The horizon can't go backwards, and we can only compare it with xmin
+	 * until the transaction counter has gone a good way around.
+	 */
+	if (previous_horizon > horizon ||
+		horizon - previous_horizon > MAX_HORIZON_AGE)
+	{
+		pgcc_log(PGCC_PROGRESS,
+				 "state file \"%s\" is too old or from another server; checking all rows\n",
+				 state_path);
+		have_previous = false;
+		return;
+	}
+
+	pgcc_log(PGCC_VERBOSE,
+			 "checking rows changed since transaction " UINT64_FORMAT "\n",
+			 previous_horizon);
+}
+
+/*
+ * Could this table be checked incrementally, if we knew what had changed?
+ * Tables that can are read with their ctids, so that we can remember which
+ * rows we reported on.
+ */
+bool
+table_supports_incremental(pg_catalog_table *tab)
+{
+	return have_horizon && table_checks_only_references(tab);
+}
+
+/*
+ * Can we check just the changed rows of this table?  We need to have checked
+ * the same columns last time, and to know which keys have gone from each
+ * table its rows refer to.
+ */
+bool
+table_is_incremental(pg_catalog_table *tab)
+{
+	table_state *state = &states[tab - pg_catalog_tables];
+	pg_catalog_column *tabcol;
+	char	   *columns;
+	bool		same_columns;
+	int			ndeleted = 0;
+
+	if (!have_previous || !state->was_checked ||
+		!table_supports_incremental(tab))
+		return false;
+
+	columns = checked_columns(tab);
+	same_columns = strcmp(columns, state->checked_columns) == 0;
+	pg_free(columns);
+	if (!same_columns || state->nold_reported > MAX_INCREMENTAL_KEYS)
+		return false;
+
+	/* If the table's been rewritten, the ctids we saved are meaningless. */
+	if (state->relfilenode == 0)
+		return false;
+	if (state->relfilenode != state->old_relfilenode)
+	{
+		pgcc_log(PGCC_VERBOSE,
+				 "table %s has been rewritten since the last run; checking all rows\n",
+				 tab->table_name);
+		return false;
+	}
+
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+	{
+		pg_catalog_check *check = tabcol->check;
+		table_state *refstate;
+
+		if (tabcol->checked != TRI_YES || check == NULL)
+			continue;
+		switch (check->type)
+		{
+			case CHECK_OID_REFERENCE:
+			case CHECK_OID_VECTOR_REFERENCE:
+			case CHECK_OID_ARRAY_REFERENCE:
+				refstate = referenced_state(check);
+				if (!refstate->have_deleted)
+					return false;
+
+				/*
+				 * We can't easily find the vectors and arrays that mention a
+				 * deleted key, so if there are any, read them all.
+				 */
+				if (check->type != CHECK_OID_REFERENCE &&
+					refstate->ndeleted > 0)
+					return false;
+				ndeleted += refstate->ndeleted;
+				break;
+			case CHECK_DEPENDENCY_ID:
+				{
+					int			n;
+
+					if (!all_deletions_known(&n))
+						return false;
+					ndeleted += n;
+				}
+				break;
+			case CHECK_DEPENDENCY_SUBID:
+				/* A sub-ID refers to a row of pg_attribute. */
+				refstate = referenced_state(check);
+				if (!refstate->have_deleted)
+					return false;
+				ndeleted += refstate->ndeleted;
+				break;
+			default:
+				break;
+		}
+	}
+
+	return ndeleted <= MAX_INCREMENTAL_KEYS;
+}
+
+/*
+ * Build a WHERE clause for a table's query, selecting the rows we have to
+ * check again: those whose xmin is at or after the previous horizon, those we
+ * reported on last time, and those referring to deleted keys.
+ *
+ * There's no ordering operator for xid, but age() measures how far back each
+ * one is from the current transaction modulo 2^32, which is the order we
+ * want as long as neither is more than 2^31 transactions old.  Frozen rows
+ * are as old as can be.
+ */
+char *
+build_incremental_filter(pg_catalog_table *tab)
+{
+	PQExpBuffer query = createPQExpBuffer();
+	char	   *result;
+	table_state *state = &states[tab - pg_catalog_tables];
+	pg_catalog_column *tabcol;
+	table_state **with_deleted;
+	int			ntables = 0;
+	bool		any_dependency = false;
+	pg_catalog_table *othertab;
+	int			i;
+
+	for (othertab = pg_catalog_tables; othertab->table_name != NULL;
+		 ++othertab)
+		ntables++;
+	with_deleted = pg_malloc(ntables * sizeof(table_state *));
+
+	appendPQExpBuffer(query,
+					  "pg_catalog.age(xmin) <= pg_catalog.age('%u'::pg_catalog.xid)",
+					  (uint32) previous_horizon);
+
+	if (state->nold_reported > 0)
+	{
+		appendPQExpBufferStr(query, " OR ctid = ANY ('{");
+		for (i = 0; i < state->nold_reported; i++)
+			appendPQExpBuffer(query, "%s\"%s\"", i > 0 ? "," : "",
+							  state->old_reported[i]);
+		appendPQExpBufferStr(query, "}'::pg_catalog.tid[])");
+	}
+
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+	{
+		pg_catalog_check *check = tabcol->check;
+
+		if (tabcol->checked != TRI_YES || check == NULL)
+			continue;
+		if (check->type == CHECK_OID_REFERENCE)
+		{
+			with_deleted[0] = referenced_state(check);
+			append_any(query, tabcol->name, tabcol->cast, 1, with_deleted);
+		}
+		else if (check->type == CHECK_DEPENDENCY_ID ||
+				 check->type == CHECK_DEPENDENCY_SUBID)
+			any_dependency = true;
+	}
+
+	/*
+	 * A dependency can refer to an object in any catalog, and a sub-ID goes
+	 * with an object ID, so look for every deleted key, and every relation
+	 * that has lost an attribute, in each object ID column, whether or not
+	 * we're checking it.
+	 */
+	if (any_dependency)
+	{
+		int			n = 0;
+
+		for (i = 0; i < ntables; i++)
+			if (states[i].ndeleted > 0)
+				with_deleted[n++] = &states[i];
+		for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+		{
+			pg_catalog_check *check = tabcol->check;
+
+			if (tabcol->available && check != NULL &&
+				check->type == CHECK_DEPENDENCY_ID)
+				append_any(query, tabcol->name, tabcol->cast, n,
+						   with_deleted);
+		}
+	}
+
+	pg_free(with_deleted);
+	result = pg_strdup(query->data);
+	destroyPQExpBuffer(query);
+
+	return result;
+}
+
+/*
+ * Add a test for whether a column matches any of the keys deleted from the
+ * given tables, if there are any.
+ */
+static void
+append_any(PQExpBuffer query, char *column, char *cast, int ntables,
+		   table_state **with_deleted)
+{
+	bool		first = true;
+	int			t;
+	int			i;
+
+	for (t = 0; t < ntables; t++)
+	{
+		for (i = 0; i < with_deleted[t]->ndeleted; i++)
+		{
+			if (first)
+			{
+				if (cast != NULL)
+					appendPQExpBuffer(query, " OR %s::%s = ANY ('{",
+									  column, cast);
+				else
+					appendPQExpBuffer(query, " OR %s = ANY ('{", column);
+			}
+			appendPQExpBuffer(query, "%s%u", first ? "" : ",",
+							  with_deleted[t]->deleted[i]);
+			first = false;
+		}
+	}
+	if (!first)
+		appendPQExpBufferStr(query, "}'::pg_catalog.oid[])");
+}
+
+/*
+ * Remember the keys of a table we've read in full, and work out which keys
+ * have gone since last time.  Only tables keyed by OID alone are of interest,
+ * since only those are referred to by OID, plus pg_attribute, which sub-IDs
+ * refer to.  For pg_attribute, what we note as deleted is the relation each
+ * vanished attribute belonged to.
+ */
+void
+incremental_note_keys(pg_catalog_table *tab)
+{
+	table_state *state = &states[tab - pg_catalog_tables];
+	int			shift;
+	int			i;
+	int			j;
+
+	if (!have_horizon || tab->store == NULL)
+		return;
+	if (table_key_is_oid(tab))
+	{
+		state->keys = read_oid_keys(tab, &state->nkeys);
+		shift = 0;
+	}
+	else if (strcmp(tab->table_name, "pg_attribute") == 0)
+	{
+		state->keys = read_attribute_keys(tab, &state->nkeys);
+		shift = ATTRIBUTE_KEY_SHIFT;
+	}
+	else
+		return;
+	if (state->keys == NULL)
+		return;
+	state->have_keys = true;
+
+	if (!have_previous || !state->have_old_keys)
+		return;
+
+	/* Both lists are sorted, so one pass finds the keys that are gone. */
+	state->deleted = pg_malloc(Max(state->nold_keys, 1) * sizeof(uint32));
+	for (i = 0, j = 0; i < state->nold_keys; i++)
+	{
+		uint32		deleted = (uint32) (state->old_keys[i] >> shift);
+
+		while (j < state->nkeys && state->keys[j] < state->old_keys[i])
+			j++;
+		if (j < state->nkeys && state->keys[j] == state->old_keys[i])
+			continue;
+		if (state->ndeleted == 0 ||
+			state->deleted[state->ndeleted - 1] != deleted)
+			state->deleted[state->ndeleted++] = deleted;
+	}
+	state->have_deleted = true;
+
+	pgcc_log(PGCC_DEBUG, "%d keys of table %s deleted since last run\n",
+			 state->ndeleted, tab->table_name);
+}
+
+/*
+ * Read the OIDs of a table keyed by OID, sorted and without duplicates.
+ * Returns NULL if any of them isn't a valid OID.
+ */
+static uint64 *
+read_oid_keys(pg_catalog_table *tab, int *nkeys)
+{
+	int			key_column;
+	int			ntups;
+	uint32	   *oids;
+	uint64	   *keys;
+	int			rownum;
+	int			i;
+	int			j;
+
+	key_column = colstore_fnumber(tab->store, "oid");
+	if (key_column == -1)
+		return NULL;
+
+	ntups = colstore_nrows(tab->store);
+	oids = pg_malloc(Max(ntups, 1) * sizeof(uint32));
+	for (rownum = 0; rownum < ntups; ++rownum)
+	{
+		if (!colstore_get_integer(tab->store, rownum, key_column, false,
+								  &oids[rownum]))
+		{
+			pg_free(oids);
+			return NULL;
+		}
+	}
+	radix_sort_oids(oids, NULL, ntups);
+
+	/* Duplicate keys are reported elsewhere; keep just one of each. */
+	keys = pg_malloc(Max(ntups, 1) * sizeof(uint64));
+	for (i = 0, j = 0; i < ntups; i++)
+		if (j == 0 || oids[i] != keys[j - 1])
+			keys[j++] = oids[i];
+	pg_free(oids);
+	*nkeys = j;
+
+	return keys;
+}
+
+/*
+ * Read the (attrelid, attnum) keys of pg_attribute, sorted and without
+ * duplicates.  We sort the rows by attnum and then, stably, by attrelid, the
+ * way check_unique.c sorts multi-column keys.  Returns NULL if any of them
+ * isn't a valid key.
+ */
+static uint64 *
+read_attribute_keys(pg_catalog_table *tab, int *nkeys)
+{
+	int			relid_column;
+	int			attnum_column;
+	int			ntups;
+	uint32	   *codes;
+	int		   *rows;
+	uint64	   *keys;
+	int			rownum;
+	int			i;
+	int			j;
+
+	relid_column = colstore_fnumber(tab->store, "attrelid");
+	attnum_column = colstore_fnumber(tab->store, "attnum");
+	if (relid_column == -1 || attnum_column == -1)
+		return NULL;
+
+	ntups = colstore_nrows(tab->store);
+	codes = pg_malloc(Max(ntups, 1) * sizeof(uint32));
+	rows = pg_malloc(Max(ntups, 1) * sizeof(int));
+	keys = pg_malloc(Max(ntups, 1) * sizeof(uint64));
+	for (rownum = 0; rownum < ntups; ++rownum)
+	{
+		if (!colstore_get_integer(tab->store, rownum, attnum_column, true,
+								  &codes[rownum]))
+			goto bad;
+		codes[rownum] = (uint16) codes[rownum];
+		rows[rownum] = rownum;
+	}
+	radix_sort_oids(codes, rows, ntups);
+
+	for (i = 0; i < ntups; i++)
+		if (!colstore_get_integer(tab->store, rows[i], relid_column, false,
+								  &codes[i]))
+			goto bad;
+	radix_sort_oids(codes, rows, ntups);
+
+	/* Duplicate keys are reported elsewhere; keep just one of each. */
+	for (i = 0, j = 0; i < ntups; i++)
+	{
+		uint32		attnum;
+		uint64		key;
+
+		colstore_get_integer(tab->store, rows[i], attnum_column, true,
+							 &attnum);
+		key = ((uint64) codes[i] << ATTRIBUTE_KEY_SHIFT) | (uint16) attnum;
+		if (j == 0 || key != keys[j - 1])
+			keys[j++] = key;
+	}
+	pg_free(codes);
+	pg_free(rows);
+	*nkeys = j;
+
+	return keys;
+
+bad:
+	pg_free(codes);
+	pg_free(rows);
+	pg_free(keys);
+	return NULL;
+}
+
+/*
+ * Remember that we reported on a row of a table that supports incremental
+ * checking, so that we'll check it again next time.
+ */
+void
+incremental_note_reported(pg_catalog_table *tab, int rownum)
+{
+	table_state *state = &states[tab - pg_catalog_tables];
+
+	if (state->nreported >= state->nreported_allocated)
+	{
+		state->nreported_allocated = Max(state->nreported_allocated * 2, 16);
+		state->reported = pg_realloc(state->reported,
+									 state->nreported_allocated *
+									 sizeof(char *));
+	}
+	state->reported[state->nreported++] =
+		pg_strdup(colstore_getvalue(tab->store, rownum,
+									tab->ctid_result_column));
+}
+
+/*
+ * Finish an incremental run by saving what the next run needs to know.  If
+ * something went wrong, we keep the previous state instead, since we can't
+ * be sure of having checked everything we would be claiming to have checked.
+ */
+void
+finish_incremental_check(void)
+{
+	pg_catalog_table *tab;
+	int			ntables = 0;
+	long		nrows = 0;
+
+	if (!have_horizon)
+		return;
+
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+	{
+		if (!tab->incremental)
+			continue;
+		pgcc_log(PGCC_VERBOSE,
+				 "checked %ld changed rows of table %s\n",
+				 tab->rows_checked, tab->table_name);
+		ntables++;
+		nrows += tab->rows_checked;
+	}
+	if (ntables > 0)
+		pgcc_log(PGCC_PROGRESS,
+				 "checked only changed rows of %d tables (%ld rows)\n",
+				 ntables, nrows);
+	if (pgcc_log_had_errors())
+	{
+		pgcc_log(PGCC_PROGRESS,
+				 "not updating state file \"%s\" because of errors\n",
+				 state_path);
+		return;
+	}
+	write_state_file();
+}
+
+/*
+ * Find out where each catalog's rows are stored.  pg_relation_filenode()
+ * knows about mapped catalogs, whose pg_class.relfilenode is zero, but it
+ * only exists in 9.0 and later, as do mapped catalogs.  If we can't find out,
+ * we'll read every table in full.
+ */
+static void
+fetch_relfilenodes(PGconn *conn)
+{
+	PGresult   *res;
+	int			ntups;
+	int			i;
+
+	if (remote_version >= 90000)
+		res = PQexec(conn,
+					 "SELECT relname, pg_catalog.pg_relation_filenode(oid)"
+					 " FROM pg_catalog.pg_class WHERE relnamespace = 11");
+	else
+		res = PQexec(conn,
+					 "SELECT relname, relfilenode FROM pg_catalog.pg_class"
+					 " WHERE relnamespace = 11");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		pgcc_log(PGCC_WARNING,
+				 "could not determine catalog file nodes; checking all rows: %s",
+				 PQresultErrorMessage(res));
+		PQclear(res);
+		return;
+	}
+
+	ntups = PQntuples(res);
+	for (i = 0; i < ntups; ++i)
+	{
+		char	   *relname = PQgetvalue(res, i, 0);
+		pg_catalog_table *tab;
+
+		for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+		{
+			if (strcmp(tab->table_name, relname) != 0)
+				continue;
+			states[tab - pg_catalog_tables].relfilenode =
+				(uint32) strtoul(PQgetvalue(res, i, 1), NULL, 10);
+			break;
+		}
+	}
+
+	PQclear(res);
+}
+
+/*
+ * Read the state saved by the previous run.  Returns false if there isn't
+ * any we can use.
+ *
+ * The file is a sequence of whitespace-separated tokens:
+ *
+ *	pg_catcheck-incremental-state VERSION
+ *	database OID SERVER_VERSION IS_EDB
+ *	horizon XID
+ *	checked TABLE RELFILENODE COLUMNS	(once per table checked)
+ *	reported TABLE N CTID...	(once per table checked)
+ *	keys TABLE N KEY...			(once per table whose keys we saved)
+ *
+ * The keys are OIDs, except for pg_attribute's; see ATTRIBUTE_KEY_SHIFT.
+ *	end
+ */
+static bool
+read_state_file(FILE *f)
+{
+	char		word[NAMEDATALEN * 4];
+	int			version;
+	char		dboid[32];
+	int			server_version;
+	int			is_edb;
+
+	if (fscanf(f, "%255s %d", word, &version) != 2 ||
+		strcmp(word, STATE_FILE_HEADER) != 0)
+		goto bad;
+	if (version != STATE_FILE_VERSION)
+	{
+		pgcc_log(PGCC_PROGRESS,
+				 "state file \"%s\" is from a different version of pg_catcheck; checking all rows\n",
+				 state_path);
+		return false;
+	}
+	if (fscanf(f, " database %31s %d %d", dboid, &server_version,
+			   &is_edb) != 3)
+		goto bad;
+	if (strcmp(dboid, database_oid != NULL ? database_oid : "0") != 0 ||
+		server_version != remote_version || is_edb != (int) remote_is_edb)
+	{
+		pgcc_log(PGCC_PROGRESS,
+				 "state file \"%s\" is for a different database or server; checking all rows\n",
+				 state_path);
+		return false;
+	}
+	if (fscanf(f, " horizon " UINT64_FORMAT, &previous_horizon) != 1)
+		goto bad;
+
+	while (fscanf(f, "%255s", word) == 1)
+	{
+		char		table_name[NAMEDATALEN * 4];
+		table_state *state;
+		pg_catalog_table *tab;
+		int			n;
+		int			i;
+
+		if (strcmp(word, "end") == 0)
+			return true;
+		if (fscanf(f, "%255s", table_name) != 1)
+			goto bad;
+		for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+			if (strcmp(tab->table_name, table_name) == 0)
+				break;
+		if (tab->table_name == NULL)
+			goto bad;
+		state = &states[tab - pg_catalog_tables];
+
+		if (strcmp(word, "checked") == 0)
+		{
+			char		columns[8192];
+
+			if (fscanf(f, "%u %8191s", &state->old_relfilenode,
+					   columns) != 2)
+				goto bad;
+			state->was_checked = true;
+			state->checked_columns = pg_strdup(columns);
+		}
+		else if (strcmp(word, "reported") == 0)
+		{
+			if (fscanf(f, "%d", &n) != 1 || n < 0)
+				goto bad;
+			state->old_reported = pg_malloc(Max(n, 1) * sizeof(char *));
+			for (i = 0; i < n; i++)
+			{
+				char		ctid[64];
+
+				if (fscanf(f, "%63s", ctid) != 1)
+					goto bad;
+				state->old_reported[i] = pg_strdup(ctid);
+				state->nold_reported++;
+			}
+		}
+		else if (strcmp(word, "keys") == 0)
+		{
+			if (fscanf(f, "%d", &n) != 1 || n < 0 ||
+				!read_keys(f, n, &state->old_keys))
+				goto bad;
+			state->nold_keys = n;
+			state->have_old_keys = true;
+		}
+		else
+			goto bad;
+	}
+
+bad:
+	pgcc_log(PGCC_WARNING,
+			 "state file \"%s\" is invalid; checking all rows\n",
+			 state_path);
+	return false;
+}
+
+/*
+ * Read n keys from the state file, which saved them in sorted order.
+ */
+static bool
+read_keys(FILE *f, int n, uint64 **keys)
+{
+	int			i;
+
+	*keys = pg_malloc(Max(n, 1) * sizeof(uint64));
+	for (i = 0; i < n; i++)
+	{
+		uint64		key;
+
+		if (fscanf(f, UINT64_FORMAT, &key) != 1 ||
+			(i > 0 && key <= (*keys)[i - 1]))
+			return false;
+		(*keys)[i] = key;
+	}
+	return true;
+}
+
+/*
+ * Save this run's state.  We write a new file and rename it over the old
+ * one, so that a crash can't leave a partial file behind.
+ */
+static void
+write_state_file(void)
+{
+	PQExpBuffer temp_path = createPQExpBuffer();
+	pg_catalog_table *tab;
+	FILE	   *f;
+
+	appendPQExpBuffer(temp_path, "%s.tmp", state_path);
+	f = fopen(temp_path->data, "w");
+	if (f == NULL)
+	{
+		pgcc_log(PGCC_ERROR, "could not create state file \"%s\": %s\n",
+				 temp_path->data, strerror(errno));
+		destroyPQExpBuffer(temp_path);
+		return;
+	}
+
+	fprintf(f, "%s %d\n", STATE_FILE_HEADER, STATE_FILE_VERSION);
+	fprintf(f, "database %s %d %d\n",
+			database_oid != NULL ? database_oid : "0", remote_version,
+			(int) remote_is_edb);
+	fprintf(f, "horizon " UINT64_FORMAT "\n", horizon);
+
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+	{
+		table_state *state = &states[tab - pg_catalog_tables];
+		int			i;
+
+		/*
+		 * A table counts as checked if we read its ctids, which means it
+		 * supports incremental checking.  Had we failed to load it, there
+		 * would have been an error, and we wouldn't be here.
+		 */
+		if (tab->ctid_result_column != -1 && !tab->needs_check)
+		{
+			char	   *columns = checked_columns(tab);
+
+			fprintf(f, "checked %s %u %s\n", tab->table_name,
+					state->relfilenode, columns);
+			pg_free(columns);
+			fprintf(f, "reported %s %d", tab->table_name, state->nreported);
+			for (i = 0; i < state->nreported; i++)
+				fprintf(f, "%s%s", i % 8 == 0 ? "\n" : " ",
+						state->reported[i]);
+			fprintf(f, "\n");
+		}
+
+		if (state->have_keys)
+		{
+			fprintf(f, "keys %s %d", tab->table_name, state->nkeys);
+			for (i = 0; i < state->nkeys; i++)
+				fprintf(f, "%s" UINT64_FORMAT, i % 10 == 0 ? "\n" : " ",
+						state->keys[i]);
+			fprintf(f, "\n");
+		}
+	}
+	fprintf(f, "end\n");
+
+	if (ferror(f) | (fclose(f) != 0))
+	{
+		pgcc_log(PGCC_ERROR, "could not write state file \"%s\"\n",
+				 temp_path->data);
+		remove(temp_path->data);
+	}
+	else if (rename(temp_path->data, state_path) != 0)
+		pgcc_log(PGCC_ERROR, "could not rename \"%s\" to \"%s\": %s\n",
+				 temp_path->data, state_path, strerror(errno));
+	else
+		pgcc_log(PGCC_VERBOSE, "saved state to \"%s\"\n", state_path);
+
+	destroyPQExpBuffer(temp_path);
+}
+
+/*
+ * The names of the columns of a table that we're checking, separated by
+ * commas, or "-" if there are none.
+ */
+static char *
+checked_columns(pg_catalog_table *tab)
+{
+	PQExpBufferData buf;
+	pg_catalog_column *tabcol;
+	char	   *result;
+
+	initPQExpBuffer(&buf);
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+		if (tabcol->checked == TRI_YES && tabcol->check != NULL)
+			appendPQExpBuffer(&buf, "%s%s", buf.len > 0 ? "," : "",
+							  tabcol->name);
+	if (buf.len == 0)
+		appendPQExpBufferStr(&buf, "-");
+	result = pg_strdup(buf.data);
+	termPQExpBuffer(&buf);
+
+	return result;
+}
+
+/*
+ * Is the table's key just its OID?
+ */
+static bool
+table_key_is_oid(pg_catalog_table *tab)
+{
+	pg_catalog_column *tabcol;
+	bool		has_oid_key = false;
+
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+	{
+		if (!tabcol->available || !tabcol->is_key_column)
+			continue;
+		if (strcmp(tabcol->name, "oid") != 0)
+			return false;
+		has_oid_key = true;
+	}
+
+	return has_oid_key;
+}
+
+/*
+ * The state of the catalog that a column check refers to: the one named by
+ * an OID reference check, or pg_attribute for a sub-ID.
+ */
+static table_state *
+referenced_state(pg_catalog_check *check)
+{
+	pg_catalog_table *reftab;
+
+	if (check->type == CHECK_DEPENDENCY_SUBID)
+		reftab = find_table_by_name("pg_attribute");
+	else
+		reftab = find_table_by_name(((pg_catalog_check_oid *) check)->oid_references_table);
+	return &states[reftab - pg_catalog_tables];
+}
+
+/*
+ * Do we know which keys have gone from every catalog whose keys we've read?
+ * A dependency check can refer to any of them, and it loads them all before
+ * the table it checks; catalogs we haven't read in full can't be referred to.
+ * If so, also return how many keys have gone in all.
+ */
+static bool
+all_deletions_known(int *ndeleted)
+{
+	pg_catalog_table *tab;
+
+	*ndeleted = 0;
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+	{
+		table_state *state = &states[tab - pg_catalog_tables];
+
+		if (!state->have_keys)
+			continue;
+		if (!state->have_deleted)
+			return false;
+		*ndeleted += state->ndeleted;
+	}
+
+	return true;
+}
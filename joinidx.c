@@ -0,0 +1,151 @@
+/*-------------------------------------------------------------------------
+ *
+ * joinidx.c
+ *
+ * Join indexes: for an OID column that refers to another catalog, the row
+ * of that catalog each row refers to, as an array of row numbers.
+ *
+ * Several checks follow the same references.  pg_attribute.attrelid leads
+ * to pg_class both for the attnum and relnatts checks and for the check
+ * that attrelid exists at all, and pg_class.relnamespace leads to
+ * pg_namespace both for its own check and for --select-from-relations.
+ * Rather than each probing the referenced table's hash table for every
+ * row, a check that needs the referenced rows asks for a join index when
+ * it's being set up, and the first one to use it builds it, with at most
+ * one probe per row.  Checks that only need to know whether the referenced
+ * row exists use a join index if some other check has asked for one, but
+ * don't ask for one themselves, since they'd have no one to share it with.
+ *
+ * A join index can only be built once both tables have been loaded in full,
+ * and is freed when either is compacted, since its row numbers then refer
+ * to rows that no longer exist.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include "pg_catcheck.h"
+
+/*
+ * While building a join index, we remember where recently seen OIDs led in a
+ * small direct-mapped memo, since columns such as relnamespace and attrelid
+ * contain the same few values over and over again.
+ */
+#define JOIN_MEMO_BITS		6
+#define JOIN_MEMO_SIZE		(1 << JOIN_MEMO_BITS)
+
+typedef struct join_memo_entry
+{
+	uint32		oid;
+	bool		valid;			/* is this entry in use? */
+	int			rownum;			/* referenced row, or -1 */
+} join_memo_entry;
+
+/*
+ * Note that a check will want the rows of reftab referenced by the given
+ * column of tab.
+ */
+void
+request_join_index(pg_catalog_table *tab, pg_catalog_column *tabcol,
+				   pg_catalog_table *reftab)
+{
+	Assert(tabcol->join_table == NULL || tabcol->join_table == reftab);
+
+	tabcol->join_table = reftab;
+	tabcol->join_requests++;
+	tabcol->needed = true;
+}
+
+/*
+ * Get the join index for a column, building it on first use.  Each entry is
+ * the number of the referenced table's row that the row refers to, or -1 if
+ * there's no such row.  Returns NULL if no check asked for the index, or if
+ * it can't be built, because one of the tables hasn't been loaded in full
+ * or the column isn't there.
+ */
+int *
+get_join_index(pg_catalog_table *tab, pg_catalog_column *tabcol)
+{
+	pg_catalog_table *reftab = tabcol->join_table;
+	int			column;
+	int			ntups;
+	int			nprobes = 0;
+	join_memo_entry memo[JOIN_MEMO_SIZE];
+	int			rownum;
+
+	if (tabcol->join_index != NULL)
+		return tabcol->join_index;
+
+	if (reftab == NULL ||
+		tab->store == NULL || tab->needs_load ||
+		reftab->store == NULL || reftab->needs_load || reftab->ht == NULL)
+		return NULL;
+	column = colstore_fnumber(tab->store, tabcol->name);
+	if (column == -1)
+		return NULL;
+
+	/* A value that isn't a well-formed OID is looked up as text. */
+	memset(memo, 0, sizeof(memo));
+	ntups = colstore_nrows(tab->store);
+	tabcol->join_index = pg_malloc(Max(ntups, 1) * sizeof(int));
+	for (rownum = 0; rownum < ntups; ++rownum)
+	{
+		uint32		oid;
+
+		if (colstore_get_integer(tab->store, rownum, column, false, &oid))
+		{
+			join_memo_entry *entry;
+
+			/* Fibonacci hashing: take the high bits of the product. */
+			entry = &memo[(oid * 0x9e3779b9U) >> (32 - JOIN_MEMO_BITS)];
+			if (!entry->valid || entry->oid != oid)
+			{
+				entry->oid = oid;
+				entry->valid = true;
+				entry->rownum = pgrhash_get_integer(reftab->ht, &oid);
+				nprobes++;
+			}
+			tabcol->join_index[rownum] = entry->rownum;
+		}
+		else
+		{
+			char	   *val = colstore_getvalue(tab->store, rownum, column);
+
+			tabcol->join_index[rownum] = pgrhash_get(reftab->ht, &val);
+			nprobes++;
+		}
+	}
+
+	pgcc_log(PGCC_DEBUG,
+			 "built join index from %s.%s to %s (%d rows, %d probes)\n",
+			 tab->table_name, tabcol->name, reftab->table_name, ntups,
+			 nprobes);
+
+	return tabcol->join_index;
+}
+
+/*
+ * Free the join indexes from or to a table whose rows are about to be
+ * discarded.
+ */
+void
+release_join_indexes(pg_catalog_table *tab)
+{
+	pg_catalog_table *othertab;
+
+	for (othertab = pg_catalog_tables; othertab->table_name != NULL;
+		 ++othertab)
+	{
+		pg_catalog_column *tabcol;
+
+		for (tabcol = othertab->cols; tabcol->name != NULL; ++tabcol)
+		{
+			if (tabcol->join_index == NULL ||
+				(othertab != tab && tabcol->join_table != tab))
+				continue;
+			pg_free(tabcol->join_index);
+			tabcol->join_index = NULL;
+		}
+	}
+}
@@ -12,6 +12,7 @@
 #include "postgres_fe.h"
 
 #include "pg_catcheck.h"
+#include "pqexpbuffer.h"
 
 bool		quiet = false;		/* Don't display progress messages. */
 int			verbose = 0;		/* 1 = verbose messages; 2+ = debug messages */
@@ -21,7 +22,30 @@ static int	warnings = 0;
 static int	errors = 0;
 static pgcc_severity highest_message_severity = PGCC_DEBUG;
 
+/*
+ * When check_table() runs one column at a time over a block of rows, the
+ * reports for that block are held here and sorted back into the order in
+ * which checking row by row, column by column would have produced them.
+ */
+typedef struct deferred_report
+{
+	int			rownum;
+	int			column;			/* column being checked when reported */
+	int			seq;			/* order of reports for same row/column */
+	char	   *text;
+} deferred_report;
+
+static bool deferring_reports = false;
+static int	deferred_column;
+static int	num_deferred;
+static int	num_deferred_allocated;
+static deferred_report *deferred;
+
 static bool pgcc_log_severity(pgcc_severity sev);
+static void count_severity(pgcc_severity sev);
+static char *format_message_va(const char *fmt, va_list args);
+static int	emit_deferred_reports(int *rows);
+static int	deferred_report_cmp(const void *a, const void *b);
 
 /*
  * Log a message.  We write messages of level NOTICE and below to standard
@@ -32,6 +56,10 @@ pgcc_log(pgcc_severity sev, char *fmt,...)
 {
 	va_list		args;
 
+	/* Don't lose pending reports if we're about to exit. */
+	if (sev >= PGCC_FATAL && deferring_reports)
+		emit_deferred_reports(NULL);
+
 	if (!pgcc_log_severity(sev))
 		return;
 
@@ -56,16 +84,25 @@ pgcc_report(pg_catalog_table *tab, pg_catalog_column *tabcol,
 	va_list		args;
 	pg_catalog_column *displaytabcol;
 	bool		first = true;
+	PQExpBuffer buf;
+	char	   *msg;
 
-	if (!pgcc_log_severity(PGCC_NOTICE))
-		return;
+	count_severity(PGCC_NOTICE);
+	tab->inconsistencies++;
+
+	buf = createPQExpBuffer();
+	appendPQExpBufferStr(buf, "notice: ");
 	if (tabcol != NULL)
-		printf("%s row has invalid %s \"%s\": ", tab->table_name, tabcol->name,
-			   PQgetvalue(tab->data, rownum, tabcol->result_column));
+		appendPQExpBuffer(buf, "%s row has invalid %s \"%s\": ",
+						  tab->table_name, tabcol->name,
+						  colstore_getvalue(tab->store, rownum,
+											tabcol->result_column));
 
 	va_start(args, fmt);
-	vfprintf(stdout, fmt, args);
+	msg = format_message_va(fmt, args);
 	va_end(args);
+	appendPQExpBufferStr(buf, msg);
+	pg_free(msg);
 
 	for (displaytabcol = tab->cols;
 		 displaytabcol->name != NULL;
@@ -73,14 +110,174 @@ pgcc_report(pg_catalog_table *tab, pg_catalog_column *tabcol,
 	{
 		if (displaytabcol->is_display_column)
 		{
-			printf("%s%s=\"%s\"", first ?
-				   "row identity: " : " ", displaytabcol->name,
-				PQgetvalue(tab->data, rownum, displaytabcol->result_column));
+			appendPQExpBuffer(buf, "%s%s=\"%s\"", first ?
+							  "row identity: " : " ", displaytabcol->name,
+							  colstore_getvalue(tab->store, rownum,
+										displaytabcol->result_column));
 			first = false;
 		}
 	}
 	if (!first)
-		printf("\n");
+		appendPQExpBufferChar(buf, '\n');
+
+	if (!deferring_reports)
+		fputs(buf->data, stdout);
+	else
+	{
+		deferred_report *report;
+
+		if (num_deferred >= num_deferred_allocated)
+		{
+			num_deferred_allocated = Max(num_deferred_allocated * 2, 64);
+			deferred = pg_realloc(deferred,
+								  num_deferred_allocated *
+								  sizeof(deferred_report));
+		}
+		report = &deferred[num_deferred];
+		report->rownum = rownum;
+		report->column = deferred_column;
+		report->seq = num_deferred;
+		report->text = pg_strdup(buf->data);
+		num_deferred++;
+	}
+
+	destroyPQExpBuffer(buf);
+}
+
+/*
+ * Start holding back reports rather than printing them immediately.
+ */
+void
+pgcc_begin_deferred_reports(void)
+{
+	Assert(!deferring_reports && num_deferred == 0);
+	deferring_reports = true;
+	deferred_column = 0;
+}
+
+/*
+ * Note which column is being checked, so that reports can be sorted first by
+ * row and then by column.  Reports that don't concern a particular column
+ * sort with those for the column whose check produced them.
+ */
+void
+pgcc_set_deferred_report_column(int column)
+{
+	deferred_column = column;
+}
+
+/*
+ * Print the reports held back since pgcc_begin_deferred_reports(), in order
+ * of row, then column, then time of reporting, and stop deferring.  Returns
+ * the number of distinct rows reported on; if rows isn't NULL, their numbers
+ * are stored there in ascending order.
+ */
+int
+pgcc_end_deferred_reports(int *rows)
+{
+	Assert(deferring_reports);
+	return emit_deferred_reports(rows);
+}
+
+static int
+emit_deferred_reports(int *rows)
+{
+	int			nrows = 0;
+	int			i;
+
+	deferring_reports = false;
+	if (num_deferred == 0)
+		return 0;
+
+	qsort(deferred, num_deferred, sizeof(deferred_report),
+		  deferred_report_cmp);
+	for (i = 0; i < num_deferred; i++)
+	{
+		if (i == 0 || deferred[i].rownum != deferred[i - 1].rownum)
+		{
+			if (rows != NULL)
+				rows[nrows] = deferred[i].rownum;
+			nrows++;
+		}
+		fputs(deferred[i].text, stdout);
+		pg_free(deferred[i].text);
+	}
+	num_deferred = 0;
+
+	return nrows;
+}
+
+/*
+ * qsort comparator for deferred reports.
+ */
+static int
+deferred_report_cmp(const void *a, const void *b)
+{
+	const deferred_report *ra = a;
+	const deferred_report *rb = b;
+
+	if (ra->rownum != rb->rownum)
+		return ra->rownum < rb->rownum ? -1 : 1;
+	if (ra->column != rb->column)
+		return ra->column < rb->column ? -1 : 1;
+	if (ra->seq != rb->seq)
+		return ra->seq < rb->seq ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Format a message into freshly allocated memory.
+ */
+static char *
+format_message_va(const char *fmt, va_list args)
+{
+	size_t		len = 128;
+
+	for (;;)
+	{
+		char	   *result = pg_malloc(len);
+		va_list		args_copy;
+		int			needed;
+
+		va_copy(args_copy, args);
+		needed = vsnprintf(result, len, fmt, args_copy);
+		va_end(args_copy);
+
+		if (needed >= 0 && (size_t) needed < len)
+			return result;
+		pg_free(result);
+		len = (needed >= 0) ? (size_t) needed + 1 : len * 2;
+	}
+}
+
+/*
+ * Have any errors been logged so far?
+ */
+bool
+pgcc_log_had_errors(void)
+{
+	return errors > 0;
+}
+
+/*
+ * Have any inconsistencies been reported so far?
+ */
+bool
+pgcc_log_had_inconsistencies(void)
+{
+	return notices > 0;
+}
+
+/*
+ * Count inconsistencies reported by an earlier run that this one is carrying
+ * on from, as if we'd reported them ourselves.
+ */
+void
+pgcc_log_add_inconsistencies(int ninconsistencies)
+{
+	notices += ninconsistencies;
+	if (ninconsistencies > 0 && highest_message_severity < PGCC_NOTICE)
+		highest_message_severity = PGCC_NOTICE;
 }
 
 /*
@@ -101,7 +298,7 @@ pgcc_log_completion(void)
 }
 
 /*
- * Common code for pgcc_log() and pgcc_report().
+ * Subroutine for pgcc_log().
  *
  * Determine whether a message of the indicated severity should be logged
  * given the command-line options specified by the user, and print out the
@@ -145,6 +342,17 @@ pgcc_log_severity(pgcc_severity sev)
 			break;
 	}
 
+	count_severity(sev);
+
+	return true;
+}
+
+/*
+ * Update the statistics on what messages have been logged.
+ */
+static void
+count_severity(pgcc_severity sev)
+{
 	if (sev == PGCC_NOTICE)
 		++notices;
 	if (sev == PGCC_WARNING)
@@ -154,6 +362,4 @@ pgcc_log_severity(pgcc_severity sev)
 
 	if (sev >= highest_message_severity)
 		highest_message_severity = sev;
-
-	return true;
 }
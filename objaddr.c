@@ -0,0 +1,229 @@
+/*-------------------------------------------------------------------------
+ *
+ * objaddr.c
+ *
+ * Index of object addresses, that is, (class, object ID) pairs, across all
+ * of the catalogs whose only key is an OID.
+ *
+ * Catalogs such as pg_depend, pg_shdepend and pg_description can refer to
+ * an object in any such catalog.  Rather than first finding the right table
+ * and then probing its own hash table with the text form of the OID, the
+ * dependency checks resolve the class to a small integer and then make one
+ * probe here.  All entries live in a single open-addressed array of
+ * integers, so a probe typically touches a single cache line.
+ *
+ * The caller chooses the class numbers; they need only be non-negative and
+ * distinct for distinct catalogs.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include "pg_catcheck.h"
+
+typedef struct objaddr_entry
+{
+	uint64		key;			/* class number + 1, object ID; 0 if unused */
+	int			rownum;			/* row number in the class's catalog */
+} objaddr_entry;
+
+struct objaddr_index
+{
+	uint32		nslots;			/* size of entries array, a power of 2 */
+	uint32		nentries;		/* number of slots in use */
+	objaddr_entry *entries;
+
+	/* Statistics, maintained only if collect_stats is set. */
+	bool		collect_stats;
+	uint64		lookups;		/* calls to objaddr_index_get() */
+	uint64		hits;			/* ... that found a match */
+	uint64		probes;			/* slots examined by objaddr_index_get() */
+};
+
+static inline uint64 objaddr_key(int classno, Oid objid);
+static inline uint32 objaddr_hash(uint64 key);
+static void objaddr_index_grow(objaddr_index *idx);
+
+/*
+ * Create an empty index sized for the given number of entries.  The index
+ * is enlarged as needed if more entries are inserted.
+ */
+objaddr_index *
+objaddr_index_create(int expected_entries)
+{
+	objaddr_index *idx;
+
+	idx = pg_malloc(sizeof(objaddr_index));
+	idx->nslots = 16;
+	while (idx->nslots / 2 < (uint32) Max(expected_entries, 0))
+	{
+		if (idx->nslots >= ((uint32) 1) << 30)
+			pgcc_log(PGCC_FATAL, "too many objects");
+		idx->nslots *= 2;
+	}
+	idx->nentries = 0;
+	idx->entries = pg_malloc0(idx->nslots * sizeof(objaddr_entry));
+	idx->collect_stats = (verbose >= 2);
+	idx->lookups = 0;
+	idx->hits = 0;
+	idx->probes = 0;
+
+	return idx;
+}
+
+/*
+ * Free an index.
+ */
+void
+objaddr_index_destroy(objaddr_index *idx)
+{
+	pg_free(idx->entries);
+	pg_free(idx);
+}
+
+/*
+ * Add an object to the index, unless it is already present.
+ *
+ * The return value is -1 on success, or the row number already recorded
+ * for the same object.
+ */
+int
+objaddr_index_insert(objaddr_index *idx, int classno, Oid objid, int rownum)
+{
+	uint64		key = objaddr_key(classno, objid);
+	uint32		mask;
+	uint32		i;
+
+	/* Keep the load factor at or below one half. */
+	if (idx->nentries >= idx->nslots / 2)
+		objaddr_index_grow(idx);
+
+	mask = idx->nslots - 1;
+	for (i = objaddr_hash(key) & mask; idx->entries[i].key != 0;
+		 i = (i + 1) & mask)
+		if (idx->entries[i].key == key)
+			return idx->entries[i].rownum;
+
+	idx->entries[i].key = key;
+	idx->entries[i].rownum = rownum;
+	idx->nentries++;
+
+	return -1;
+}
+
+/*
+ * Look up an object.  The return value is the row number recorded for it,
+ * or -1 if there is no such object.
+ */
+int
+objaddr_index_get(objaddr_index *idx, int classno, Oid objid)
+{
+	uint64		key = objaddr_key(classno, objid);
+	uint32		mask = idx->nslots - 1;
+	uint32		i;
+	uint64		probes = 0;
+	int			result = -1;
+
+	for (i = objaddr_hash(key) & mask; idx->entries[i].key != 0;
+		 i = (i + 1) & mask)
+	{
+		probes++;
+		if (idx->entries[i].key == key)
+		{
+			result = idx->entries[i].rownum;
+			break;
+		}
+	}
+
+	if (idx->collect_stats)
+	{
+		idx->lookups++;
+		idx->probes += probes;
+		if (result != -1)
+			idx->hits++;
+	}
+
+	return result;
+}
+
+/*
+ * Report statistics for the index at PGCC_DEBUG level, in the same format
+ * used by pgrhash_report_stats().
+ */
+void
+objaddr_index_report_stats(objaddr_index *idx)
+{
+	if (!idx->collect_stats)
+		return;
+
+	pgcc_log(PGCC_DEBUG,
+			 "object address index: %u slots, %u entries, load factor %.2f, %.1f%% of lookups found a match\n",
+			 idx->nslots, idx->nentries,
+			 (double) idx->nentries / idx->nslots,
+			 idx->lookups == 0 ? 0.0 : 100.0 * idx->hits / idx->lookups);
+	pgcc_log(PGCC_DEBUG,
+			 "hashstats: table=objaddr slots=%u entries=%u lookups=" UINT64_FORMAT " hits=" UINT64_FORMAT " probes=" UINT64_FORMAT " probes_per_lookup=%.3f\n",
+			 idx->nslots, idx->nentries, idx->lookups, idx->hits,
+			 idx->probes,
+			 idx->lookups == 0 ? 0.0 : (double) idx->probes / idx->lookups);
+}
+
+/*
+ * Pack a class number and object ID into a single non-zero key.
+ */
+static inline uint64
+objaddr_key(int classno, Oid objid)
+{
+	Assert(classno >= 0);
+	return ((uint64) (classno + 1) << 32) | objid;
+}
+
+/*
+ * Hash a key.  This is the 64-bit finalizer from MurmurHash3, which spreads
+ * the mostly-consecutive OIDs of a catalog evenly over the low-order bits.
+ */
+static inline uint32
+objaddr_hash(uint64 key)
+{
+	key ^= key >> 33;
+	key *= UINT64CONST(0xff51afd7ed558ccd);
+	key ^= key >> 33;
+	key *= UINT64CONST(0xc4ceb9fe1a85ec53);
+	key ^= key >> 33;
+
+	return (uint32) key;
+}
+
+/*
+ * Double the size of the index, reinserting the existing entries.
+ */
+static void
+objaddr_index_grow(objaddr_index *idx)
+{
+	objaddr_entry *old_entries = idx->entries;
+	uint32		old_nslots = idx->nslots;
+	uint32		mask;
+	uint32		i;
+
+	if (old_nslots >= ((uint32) 1) << 30)
+		pgcc_log(PGCC_FATAL, "too many objects");
+
+	idx->nslots = old_nslots * 2;
+	idx->entries = pg_malloc0(idx->nslots * sizeof(objaddr_entry));
+	mask = idx->nslots - 1;
+
+	for (i = 0; i < old_nslots; i++)
+	{
+		uint32		j;
+
+		if (old_entries[i].key == 0)
+			continue;
+		for (j = objaddr_hash(old_entries[i].key) & mask;
+			 idx->entries[j].key != 0; j = (j + 1) & mask)
+			;
+		idx->entries[j] = old_entries[i];
+	}
+
+	pg_free(old_entries);
+}
@@ -0,0 +1,262 @@
+/*-------------------------------------------------------------------------
+ *
+ * oidset.c
+ *
+ * Compact, immutable set of OIDs, used to answer "does this OID exist?"
+ * for catalogs whose rows are needed for nothing else.
+ *
+ * The representation follows the "Roaring bitmap" scheme.  The 32-bit OID
+ * space is split into chunks of 65536 values, keyed by the high 16 bits.
+ * Each non-empty chunk is a container holding the low 16 bits of its
+ * members either as a sorted array, when it has few members, or as a
+ * 65536-bit bitmap, when it has many; the crossover is the point at which
+ * the array would outgrow the bitmap's 8kB.  Catalog OIDs are allocated
+ * from a counter, so a set typically has a handful of containers, and a
+ * lookup is a short binary search followed by either a bit test or a
+ * binary search over at most 4096 entries.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include "pg_catcheck.h"
+
+/* Containers with more members than this are stored as bitmaps. */
+#define OIDSET_MAX_ARRAY		4096
+#define OIDSET_BITMAP_WORDS		(65536 / 64)
+
+typedef struct oidset_container
+{
+	uint16		high;			/* high 16 bits shared by all members */
+	bool		is_bitmap;		/* bitmap rather than sorted array? */
+	int			cardinality;	/* number of members */
+	union
+	{
+		uint16	   *array;		/* sorted low 16 bits of members */
+		uint64	   *bitmap;		/* OIDSET_BITMAP_WORDS words */
+	}			data;
+} oidset_container;
+
+struct oidset
+{
+	int			ncontainers;
+	int			cardinality;
+	Size		memory;			/* bytes allocated for this set */
+	oidset_container *containers;	/* sorted by high */
+};
+
+
+/*
+ * Build a set from an array of OIDs, which need not be sorted or distinct.
+ * The array is sorted in place; the caller may free it afterwards.
+ */
+oidset *
+oidset_create(uint32 *oids, int noids)
+{
+	oidset	   *set;
+	int			i;
+	int			ndistinct;
+	int			ncontainers;
+
+	radix_sort_oids(oids, NULL, noids);
+
+	/* Remove duplicates and count the containers we'll need. */
+	ndistinct = 0;
+	ncontainers = 0;
+	for (i = 0; i < noids; i++)
+	{
+		if (ndistinct > 0 && oids[ndistinct - 1] == oids[i])
+			continue;
+		if (ndistinct == 0 || (oids[ndistinct - 1] >> 16) != (oids[i] >> 16))
+			ncontainers++;
+		oids[ndistinct++] = oids[i];
+	}
+
+	set = pg_malloc(sizeof(oidset));
+	set->ncontainers = ncontainers;
+	set->cardinality = ndistinct;
+	set->containers = pg_malloc(Max(ncontainers, 1) * sizeof(oidset_container));
+	set->memory = sizeof(oidset) + ncontainers * sizeof(oidset_container);
+
+	/* Fill each container from the run of OIDs sharing its high bits. */
+	ncontainers = 0;
+	for (i = 0; i < ndistinct;)
+	{
+		oidset_container *c = &set->containers[ncontainers++];
+		int			start = i;
+		int			j;
+
+		c->high = oids[i] >> 16;
+		while (i < ndistinct && (oids[i] >> 16) == c->high)
+			i++;
+		c->cardinality = i - start;
+		c->is_bitmap = (c->cardinality > OIDSET_MAX_ARRAY);
+
+		if (c->is_bitmap)
+		{
+			c->data.bitmap = pg_malloc0(OIDSET_BITMAP_WORDS * sizeof(uint64));
+			for (j = start; j < i; j++)
+			{
+				uint16		low = oids[j] & 0xFFFF;
+
+				c->data.bitmap[low / 64] |= UINT64CONST(1) << (low % 64);
+			}
+			set->memory += OIDSET_BITMAP_WORDS * sizeof(uint64);
+		}
+		else
+		{
+			c->data.array = pg_malloc(c->cardinality * sizeof(uint16));
+			for (j = start; j < i; j++)
+				c->data.array[j - start] = oids[j] & 0xFFFF;
+			set->memory += c->cardinality * sizeof(uint16);
+		}
+	}
+
+	return set;
+}
+
+/*
+ * Test whether an OID is a member of the set.
+ */
+bool
+oidset_contains(oidset *set, uint32 oid)
+{
+	uint16		high = oid >> 16;
+	uint16		low = oid & 0xFFFF;
+	oidset_container *c = NULL;
+	int			lo;
+	int			hi;
+
+	/* Find the container. */
+	lo = 0;
+	hi = set->ncontainers - 1;
+	while (lo <= hi)
+	{
+		int			mid = (lo + hi) / 2;
+
+		if (set->containers[mid].high == high)
+		{
+			c = &set->containers[mid];
+			break;
+		}
+		if (set->containers[mid].high < high)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	if (c == NULL)
+		return false;
+
+	if (c->is_bitmap)
+		return (c->data.bitmap[low / 64] & (UINT64CONST(1) << (low % 64))) != 0;
+
+	/* Search the array. */
+	lo = 0;
+	hi = c->cardinality - 1;
+	while (lo <= hi)
+	{
+		int			mid = (lo + hi) / 2;
+
+		if (c->data.array[mid] == low)
+			return true;
+		if (c->data.array[mid] < low)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return false;
+}
+
+/*
+ * Number of distinct members of the set.
+ */
+int
+oidset_cardinality(oidset *set)
+{
+	return set->cardinality;
+}
+
+/*
+ * Bytes of memory allocated for the set.
+ */
+Size
+oidset_memory(oidset *set)
+{
+	return set->memory;
+}
+
+/*
+ * Sort an array of OIDs in place, carrying along a parallel array of row
+ * numbers if rows isn't NULL.
+ *
+ * This is a least-significant-digit radix sort, one byte at a time, so it's
+ * stable and takes linear time.  A byte that's the same in every key, as
+ * the high bytes of catalog OIDs usually are, costs only the counting pass.
+ */
+void
+radix_sort_oids(uint32 *oids, int *rows, int noids)
+{
+	uint32	   *tmp_oids;
+	int		   *tmp_rows = NULL;
+	uint32	   *src_oids = oids;
+	int		   *src_rows = rows;
+	int			shift;
+
+	if (noids < 2)
+		return;
+
+	tmp_oids = pg_malloc(noids * sizeof(uint32));
+	if (rows != NULL)
+		tmp_rows = pg_malloc(noids * sizeof(int));
+
+	for (shift = 0; shift < 32; shift += 8)
+	{
+		int			count[256];
+		int			offset;
+		int			i;
+		uint32	   *dst_oids;
+		int		   *dst_rows;
+
+		memset(count, 0, sizeof(count));
+		for (i = 0; i < noids; i++)
+			count[(src_oids[i] >> shift) & 0xFF]++;
+		if (count[(src_oids[0] >> shift) & 0xFF] == noids)
+			continue;
+
+		offset = 0;
+		for (i = 0; i < 256; i++)
+		{
+			int			n = count[i];
+
+			count[i] = offset;
+			offset += n;
+		}
+
+		dst_oids = (src_oids == oids) ? tmp_oids : oids;
+		dst_rows = (src_rows == rows) ? tmp_rows : rows;
+		for (i = 0; i < noids; i++)
+		{
+			int			pos = count[(src_oids[i] >> shift) & 0xFF]++;
+
+			dst_oids[pos] = src_oids[i];
+			if (rows != NULL)
+				dst_rows[pos] = src_rows[i];
+		}
+		src_oids = dst_oids;
+		src_rows = dst_rows;
+	}
+
+	/* If the result ended up in the scratch space, copy it back. */
+	if (src_oids != oids)
+	{
+		memcpy(oids, src_oids, noids * sizeof(uint32));
+		if (rows != NULL)
+			memcpy(rows, src_rows, noids * sizeof(int));
+	}
+
+	pg_free(tmp_oids);
+	if (tmp_rows != NULL)
+		pg_free(tmp_rows);
+}
@@ -27,6 +27,9 @@
 
 #include "pg_catcheck.h"
 #include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
 
 #if PG_VERSION_NUM >= 140000
 #include "common/string.h"
@@ -45,26 +48,60 @@ int			remote_version;
 bool		remote_is_edb;
 char	   *database_oid;
 static bool	select_from_relations = false;
+static double sample_percent = 100.0;
+static unsigned int sample_seed;
+static bool sample_seed_given = false;
+static char *incremental_path = NULL;
+static bool since_last_run = false;
+static char *checkpoint_path = NULL;
 
 #define MINIMUM_SUPPORTED_VERSION				80400
 
+/* TABLESAMPLE first appeared in 9.5. */
+#define MINIMUM_SAMPLE_VERSION					90500
+
+/*
+ * z-score for the confidence level of the bound we report on the rate of
+ * inconsistent rows when sampling: 95%, one-sided.
+ */
+#define SAMPLE_CONFIDENCE_Z						1.645
+#define SAMPLE_CONFIDENCE_PERCENT				95
+
+/* Number of rows that check_table() checks one column at a time. */
+#define CHECK_BLOCK_ROWS						1024
+
 /* Static functions */
 static int	parse_target_version(char *version);
+static double parse_sample_percent(char *percent);
+static unsigned int parse_sample_seed(char *seed);
 static void select_column(char *column_name, enum trivalue whether);
 static void select_table(char *table_name, enum trivalue whether);
 static PGconn *do_connect(void);
 static void decide_what_to_check(bool selected_columns);
 static void perform_checks(PGconn *conn);
+static void estimate_table_sizes(PGconn *conn);
 static void load_table(PGconn *conn, pg_catalog_table *tab);
+static void report_load_failure(pg_catalog_table *tab, PGresult *res);
 static void check_table(PGconn *conn, pg_catalog_table *tab);
+static void check_rows(pg_catalog_table *tab);
+static void compile_check_plan(pg_catalog_table *tab);
+static void release_check_plan(pg_catalog_table *tab);
 static PQExpBuffer build_query_for_table(pg_catalog_table *tab);
-static void build_hash_from_query_results(pg_catalog_table *tab);
+static void store_rows(pg_catalog_table *tab, PGresult *res);
+static void create_hash_for_table(pg_catalog_table *tab, int expected_rows);
+static void add_row_to_hash(pg_catalog_table *tab, int rownum);
+static void compact_table(pg_catalog_table *tab);
+static bool table_is_sampled(pg_catalog_table *tab);
+static void report_sample_bound(void);
+static double rate_upper_bound(long nreported, long nrows);
 static void usage(void);
 static char *get_database_oid(PGconn *conn);
 
 #if PG_VERSION_NUM >= 90200
 static void load_check_by_singlerow(PGconn *conn, pg_catalog_table *tab,
 								PQExpBuffer query);
+static void load_by_singlerow(PGconn *conn, pg_catalog_table *tab,
+							  PQExpBuffer query);
 #endif
 
 /*
@@ -86,6 +123,13 @@ main(int argc, char **argv)
 		{"target-version", required_argument, NULL, 101},
 		{"enterprisedb", no_argument, NULL, 102},
 		{"postgresql", no_argument, NULL, 103},
+		{"sample", required_argument, NULL, 106},
+		{"sample-seed", required_argument, NULL, 107},
+		{"incremental", required_argument, NULL, 108},
+		{"install-ddl-log", no_argument, NULL, 109},
+		{"since-last-run", no_argument, NULL, 110},
+		{"checkpoint", required_argument, NULL, 111},
+		{"resume", no_argument, NULL, 114},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -96,6 +140,8 @@ main(int argc, char **argv)
 	int			target_version = 0;
 	bool		detect_edb = true;
 	bool		selected_columns = false;
+	bool		install_only = false;
+	bool		resume = false;
 
 	progname = get_progname(argv[0]);
 
@@ -172,6 +218,28 @@ main(int argc, char **argv)
 			case 105:
 				select_from_relations = true;
 				break;
+			case 106:
+				sample_percent = parse_sample_percent(optarg);
+				break;
+			case 107:
+				sample_seed = parse_sample_seed(optarg);
+				sample_seed_given = true;
+				break;
+			case 108:
+				incremental_path = pg_strdup(optarg);
+				break;
+			case 109:
+				install_only = true;
+				break;
+			case 110:
+				since_last_run = true;
+				break;
+			case 111:
+				checkpoint_path = pg_strdup(optarg);
+				break;
+			case 114:
+				resume = true;
+				break;
 			default:
 				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
 				exit(1);
@@ -191,6 +259,39 @@ main(int argc, char **argv)
 			dbName = "";
 	}
 
+	/* A sample of the changed rows wouldn't tell us much. */
+	if (incremental_path != NULL && sample_percent < 100.0)
+	{
+		fprintf(stderr, _("%s: options --incremental and --sample cannot be used together\n"),
+				progname);
+		exit(1);
+	}
+	if (since_last_run && (incremental_path != NULL || sample_percent < 100.0))
+	{
+		fprintf(stderr, _("%s: option --since-last-run cannot be used with --incremental or --sample\n"),
+				progname);
+		exit(1);
+	}
+
+	if (resume && checkpoint_path == NULL)
+	{
+		fprintf(stderr, _("%s: option --resume requires --checkpoint\n"),
+				progname);
+		exit(1);
+	}
+
+	/*
+	 * A run that reads only some rows is quick enough to start over, and
+	 * couldn't be resumed anyway without remembering which rows it read.
+	 */
+	if (checkpoint_path != NULL &&
+		(incremental_path != NULL || since_last_run || sample_percent < 100.0))
+	{
+		fprintf(stderr, _("%s: option --checkpoint cannot be used with --incremental, --since-last-run or --sample\n"),
+				progname);
+		exit(1);
+	}
+
 	/* Complain if any arguments remain */
 	if (optind < argc)
 	{
@@ -228,6 +329,19 @@ main(int argc, char **argv)
 		pgcc_log(PGCC_WARNING, "server version (%d) is older than the minimum version supported by this tool (%d)\n",
 				 remote_version, MINIMUM_SUPPORTED_VERSION);
 
+	/*
+	 * Sampling needs TABLESAMPLE.  Unless the user picked a seed, pick one
+	 * now; it's reported at the end, so that the run can be repeated.
+	 */
+	if (sample_percent < 100.0 && remote_version < MINIMUM_SAMPLE_VERSION)
+	{
+		pgcc_log(PGCC_WARNING, "server version (%d) does not support TABLESAMPLE; reading all rows\n",
+				 remote_version);
+		sample_percent = 100.0;
+	}
+	if (sample_percent < 100.0 && !sample_seed_given)
+		sample_seed = (unsigned int) time(NULL) % 1000000;
+
 	/*
 	 * If neither --enterprisedb nor --postgresql was specified, attempt to
 	 * detect which type of database we're accessing.
@@ -268,8 +382,37 @@ main(int argc, char **argv)
 	/* Cache the OID of the current database, if possible. */
 	database_oid = get_database_oid(conn);
 
+	/* Installing the DDL log is all we do if asked to. */
+	if (install_only)
+	{
+		install_ddl_log(conn);
+		PQfinish(conn);
+		pgcc_log_completion();
+	}
+
+	/*
+	 * In incremental mode, find out where the previous run left off before
+	 * we read anything.
+	 */
+	if (incremental_path != NULL)
+		begin_incremental_check(conn, incremental_path);
+	if (since_last_run)
+		begin_ddl_log_check(conn);
+
+	/* If resuming, skip whatever the interrupted run already checked. */
+	if (checkpoint_path != NULL)
+		begin_checkpoints(conn, checkpoint_path, resume);
+
 	/* Run the checks. */
 	perform_checks(conn);
+	if (checkpoint_path != NULL)
+		finish_checkpoints();
+	if (sample_percent < 100.0)
+		report_sample_bound();
+	if (incremental_path != NULL)
+		finish_incremental_check();
+	if (since_last_run)
+		finish_ddl_log_check(conn);
 
 	/* Cleanup */
 	PQfinish(conn);
@@ -320,6 +463,45 @@ bad:
 	exit(1);
 }
 
+/*
+ * Parse the argument to --sample, a percentage of rows.
+ */
+static double
+parse_sample_percent(char *percent)
+{
+	char	   *endptr;
+	double		result;
+
+	result = strtod(percent, &endptr);
+	if (endptr == percent || *endptr != '\0' ||
+		!(result > 0.0 && result <= 100.0))
+	{
+		fprintf(stderr, _("%s: invalid argument for option --sample\n"),
+				progname);
+		fprintf(stderr, _("Sample size should be a percentage greater than 0 and at most 100.\n"));
+		exit(1);
+	}
+	return result;
+}
+
+/*
+ * Parse the argument to --sample-seed.
+ */
+static unsigned int
+parse_sample_seed(char *seed)
+{
+	uint32		result;
+
+	if (!parse_integer_key(seed, false, &result))
+	{
+		fprintf(stderr, _("%s: invalid argument for option --sample-seed\n"),
+				progname);
+		fprintf(stderr, _("Seed should be a non-negative integer.\n"));
+		exit(1);
+	}
+	return result;
+}
+
 /*
  * Select or deselect the named table.
  */
@@ -606,6 +788,17 @@ decide_what_to_check(bool selected_columns)
 				tabcol->needed = (tabcol->checked == TRI_YES)
 					|| tabcol->is_key_column || tabcol->is_display_column;
 		}
+
+		/*
+		 * A table-level check follows the table setting, or if there is none,
+		 * runs unless only specific columns are to be checked.
+		 */
+		if (tab->check == NULL || !tab->available)
+			tab->row_check_enabled = false;
+		else if (tab->checked != TRI_DEFAULT)
+			tab->row_check_enabled = (tab->checked == TRI_YES);
+		else
+			tab->row_check_enabled = !selected_columns;
 	}
 
 	/* Prepare for select_from_relations, if option been provided. */
@@ -631,7 +824,7 @@ decide_what_to_check(bool selected_columns)
 			switch (check->type)
 			{
 				case CHECK_ATTNUM:
-					prepare_to_check_relnatts(tab, tabcol);
+					prepare_to_check_attnum(tab, tabcol);
 					break;
 				case CHECK_OID_REFERENCE:
 				case CHECK_OID_VECTOR_REFERENCE:
@@ -650,6 +843,33 @@ decide_what_to_check(bool selected_columns)
 				case CHECK_RELNATTS:
 					prepare_to_check_relnatts(tab, tabcol);
 					break;
+				case CHECK_DUPLICATE_OWNER:
+				case CHECK_DEPENDENCY_GRAPH:
+				case CHECK_UNIQUE_KEY:
+					break;		/* not a column-level check */
+			}
+		}
+
+		if (tab->row_check_enabled)
+		{
+			pg_catalog_check *check = tab->check;
+
+			switch (check->type)
+			{
+				case CHECK_DUPLICATE_OWNER:
+					prepare_to_check_duplicate_owner(tab);
+					break;
+				case CHECK_DEPENDENCY_GRAPH:
+					prepare_to_check_dependency_graph(tab);
+					break;
+				case CHECK_UNIQUE_KEY:
+					prepare_to_check_unique_key(tab);
+					break;
+				default:
+					pgcc_log(PGCC_FATAL,
+							 "unexpected table-level check for table %s\n",
+							 tab->table_name);
+					break;
 			}
 		}
 	}
@@ -665,14 +885,31 @@ perform_checks(PGconn *conn)
 {
 	pg_catalog_table *tab;
 
+	/* Find out roughly how big each table is, so we can size hash tables. */
+	estimate_table_sizes(conn);
+
 	/* Initialize the table check states. */
 	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
 	{
 		pg_catalog_column *tabcol;
 
+		tab->ctid_result_column = -1;
 		if (tab->num_needed_by != 0)
 			tab->needs_load = true;
 
+		/*
+		 * A table that the run we're resuming already checked needs loading
+		 * only if some table we still have to check refers to it.
+		 */
+		if (table_already_checked(tab))
+			continue;
+
+		if (tab->row_check_enabled)
+		{
+			tab->needs_load = true;
+			tab->needs_check = true;
+		}
+
 		for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
 		{
 			if (tabcol->needed)
@@ -700,7 +937,11 @@ perform_checks(PGconn *conn)
 		for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
 		{
 			if (tab->needs_check && !tab->needs_load && tab->num_needs == 0)
+			{
 				check_table(conn, tab);
+				if (checkpoint_path != NULL)
+					save_checkpoint();
+			}
 			if (tab->needs_check)
 				++remaining;
 		}
@@ -739,6 +980,8 @@ perform_checks(PGconn *conn)
 					 "preloading table %s because it is required in order to check %s\n",
 					 reftab->table_name, best->table_name);
 			load_table(conn, reftab);
+			if (!reftab->needs_check)
+				compact_table(reftab);
 			Assert(old_num_needs > best->num_needs);
 		}
 
@@ -753,24 +996,57 @@ perform_checks(PGconn *conn)
 		/* Check the table. */
 		if (best->needs_check)
 			check_table(conn, best);
+
+		/* Other tables may need only to know which OIDs exist. */
+		compact_table(best);
+
+		/* Record our progress, in case we're interrupted. */
+		if (checkpoint_path != NULL)
+			save_checkpoint();
 	}
 
 	/* Check select-from-relations */
 	if (select_from_relations)
 		perform_select_from_relations(conn);
+
+	/* Report how the OID lookup memos behaved, if verbose mode is enabled. */
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+	{
+		pg_catalog_column *tabcol;
+
+		for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+		{
+			pg_catalog_check *check = tabcol->check;
+
+			if (tabcol->checked != TRI_YES || check == NULL)
+				continue;
+			if (check->type == CHECK_OID_REFERENCE ||
+				check->type == CHECK_OID_VECTOR_REFERENCE ||
+				check->type == CHECK_OID_ARRAY_REFERENCE)
+				report_oid_reference_stats(tab, tabcol);
+		}
+	}
+
+	/* Report how the hash tables behaved, if debugging output is enabled. */
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+		if (tab->ht != NULL)
+			pgrhash_report_stats(tab->ht, tab->table_name);
+	report_dependency_stats();
 }
 
 #if PG_VERSION_NUM >= 90200
-static void
 /*
- * load_check_by_singlerow() loads one row at a time and perform check_table()
- * immediately. This mode does not create hash for the table's key columns and
- * hence should be called only for tables that do not have any dependees.
+ * load_check_by_singlerow() loads one row at a time, collecting rows until
+ * it has a block's worth, then checks and discards them. This mode does not
+ * create hash for the table's key columns and hence should be called only for
+ * tables that do not have any dependees.
  */
+static void
 load_check_by_singlerow(PGconn *conn, pg_catalog_table *tab, PQExpBuffer query)
 {
 	PGresult   *res = NULL;
 	int			ntups = 0;
+	bool		complete = false;
 
 	if (PQsendQuery(conn, query->data) != 1)
 	{
@@ -792,20 +1068,197 @@ load_check_by_singlerow(PGconn *conn, pg_catalog_table *tab, PQExpBuffer query)
 		if (PQresultStatus(res) == PGRES_SINGLE_TUPLE)
 		{
 			ntups++;
-			tab->data = res;
-			check_table(conn, tab);
+			if (tab->store == NULL)
+				tab->store = colstore_create(res, CHECK_BLOCK_ROWS);
+			colstore_append(tab->store, res);
+			if (colstore_nrows(tab->store) >= CHECK_BLOCK_ROWS)
+			{
+				check_rows(tab);
+				colstore_truncate(tab->store);
+			}
+		}
+		else if (PQresultStatus(res) == PGRES_TUPLES_OK)
+			complete = true;
+		else
+		{
+			/* Don't let an incremental run think we checked this table. */
+			tab->ctid_result_column = -1;
+			complete = false;
 		}
 		PQclear(res);
 	}
 
+	/* Check the last, partial block. */
+	if (tab->store != NULL)
+	{
+		check_rows(tab);
+		colstore_destroy(tab->store);
+		tab->store = NULL;
+	}
+	release_check_plan(tab);
+	tab->check_complete = complete;
+
 	pgcc_log(PGCC_VERBOSE, "checked table %s (%d rows)\n", tab->table_name,
 			 ntups);
 
 exit:
 	tab->needs_check = false;
 }
+
+/*
+ * load_by_singlerow() loads a table that other tables depend on.  Rows are
+ * fetched in single-row mode and added to tab->store as they arrive, and
+ * each row is added to the table's hash as soon as we have it, so that the
+ * hash is complete as soon as the last row has been received.
+ */
+static void
+load_by_singlerow(PGconn *conn, pg_catalog_table *tab, PQExpBuffer query)
+{
+	PGresult   *res;
+	PGresult   *failure = NULL;
+
+	tab->store = NULL;
+
+	if (PQsendQuery(conn, query->data) != 1)
+	{
+		pgcc_log(PGCC_ERROR, "could not load table %s: %s",
+				 tab->table_name, PQerrorMessage(conn));
+		return;
+	}
+
+	/*
+	 * If we can't get into single-row mode, the server's answer will simply
+	 * arrive as a single result set, which we handle below.
+	 */
+	if (PQsetSingleRowMode(conn) != 1)
+		pgcc_log(PGCC_DEBUG, "could not set single-row mode for table %s\n",
+				 tab->table_name);
+
+	while ((res = PQgetResult(conn)) != NULL)
+	{
+		switch (PQresultStatus(res))
+		{
+			case PGRES_SINGLE_TUPLE:
+			case PGRES_TUPLES_OK:
+
+				/*
+				 * PGRES_TUPLES_OK either terminates the stream of single
+				 * rows, or holds the whole result set if we never got any
+				 * single rows.
+				 */
+				if (failure == NULL)
+					store_rows(tab, res);
+				PQclear(res);
+				break;
+
+			default:
+				if (failure == NULL)
+					failure = res;
+				else
+					PQclear(res);
+				break;
+		}
+	}
+
+	/* If the query failed partway through, discard whatever we got. */
+	if (failure != NULL)
+	{
+		report_load_failure(tab, failure);
+		PQclear(failure);
+		if (tab->ht != NULL)
+		{
+			pgrhash_destroy(tab->ht);
+			tab->ht = NULL;
+		}
+		if (tab->store != NULL)
+		{
+			colstore_destroy(tab->store);
+			tab->store = NULL;
+		}
+	}
+}
 #endif
 
+/*
+ * Convert the rows of a result into tab->store and add them to the table's
+ * hash.  The first result received creates the store and the hash; the
+ * caller frees each result once we're done with it.
+ */
+static void
+store_rows(pg_catalog_table *tab, PGresult *res)
+{
+	int			rownum;
+
+	if (tab->store == NULL)
+	{
+		int			expected_rows;
+
+		/*
+		 * A complete result set tells us exactly how many rows to expect;
+		 * otherwise, rows are arriving one at a time, and we go by the
+		 * server's estimate.
+		 */
+		if (PQresultStatus(res) == PGRES_TUPLES_OK)
+			expected_rows = PQntuples(res);
+		else
+			expected_rows = tab->estimated_rows;
+
+		tab->store = colstore_create(res, expected_rows);
+		create_hash_for_table(tab, expected_rows);
+	}
+
+	rownum = colstore_nrows(tab->store);
+	colstore_append(tab->store, res);
+	if (tab->ht != NULL)
+		for (; rownum < colstore_nrows(tab->store); rownum++)
+			add_row_to_hash(tab, rownum);
+}
+
+/*
+ * Fetch pg_class.reltuples for the system catalogs, so that we can size the
+ * hash tables we build for them before their rows start to arrive.  This is
+ * only an optimization, so if it doesn't work, we just carry on without.
+ */
+static void
+estimate_table_sizes(PGconn *conn)
+{
+	PGresult   *res;
+	int			ntups;
+	int			i;
+
+	res = PQexec(conn,
+				 "SELECT relname, reltuples FROM pg_catalog.pg_class"
+				 " WHERE relnamespace = 11");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		pgcc_log(PGCC_DEBUG, "could not estimate table sizes: %s",
+				 PQresultErrorMessage(res));
+		PQclear(res);
+		return;
+	}
+
+	ntups = PQntuples(res);
+	for (i = 0; i < ntups; ++i)
+	{
+		char	   *relname = PQgetvalue(res, i, 0);
+		double		reltuples = strtod(PQgetvalue(res, i, 1), NULL);
+		pg_catalog_table *tab;
+
+		for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+		{
+			if (strcmp(tab->table_name, relname) != 0)
+				continue;
+			if (reltuples > INT_MAX)
+				tab->estimated_rows = INT_MAX;
+			else if (reltuples > 0)
+				tab->estimated_rows = (int) reltuples;
+			break;
+		}
+	}
+
+	PQclear(res);
+}
+
 /*
  * Load a table into memory.
  */
@@ -813,12 +1266,17 @@ static void
 load_table(PGconn *conn, pg_catalog_table *tab)
 {
 	PQExpBuffer query;
-	bool		need_load = true;
 	int			i;
 
 	Assert(tab->needs_load);
 
 	/* Load the table data. */
+	tab->sampled = table_is_sampled(tab);
+	tab->incremental = table_is_incremental(tab) || table_uses_ddl_log(tab);
+	if (tab->incremental)
+		pgcc_log(PGCC_VERBOSE,
+				 "reading only rows of table %s that might have changed\n",
+				 tab->table_name);
 	query = build_query_for_table(tab);
 	pgcc_log(PGCC_DEBUG, "executing query: %s\n", query->data);
 
@@ -826,41 +1284,49 @@ load_table(PGconn *conn, pg_catalog_table *tab)
 	/*
 	 * If this table is not needed by any other table, then we won't need to
 	 * refer back any given row after it's processed, so we can load them one
-	 * at a time to reduce memory consumption. However, we build a special
-	 * hash table over the contents of pg_shdepend (duplicate_owner_ht) and
-	 * therefore cannot use row-at-at-time mode for that table.
+	 * at a time to reduce memory consumption. However, some table-level
+	 * checks, such as the unique key checks, look at all of a table's rows
+	 * at once, and then we can't use row-at-a-time mode.
+	 *
+	 * Otherwise, we still fetch the rows one at a time, but keep them all,
+	 * hashing each one as it arrives.
 	 */
-	if (tab->num_needed_by == 0 && strcmp(tab->table_name, "pg_shdepend") != 0)
-	{
+	if (tab->num_needed_by == 0 && !tab->needs_rows && !tab->needs_all_rows)
 		load_check_by_singlerow(conn, tab, query);
-		need_load = false;
-	}
-#endif
-
-	if (need_load)
+	else
+		load_by_singlerow(conn, tab, query);
+#else
 	{
-		tab->data = PQexec(conn, query->data);
-		if (PQresultStatus(tab->data) != PGRES_TUPLES_OK)
-		{
-			char	   *message = PQresultErrorMessage(tab->data);
+		PGresult   *res = PQexec(conn, query->data);
 
-			if (message != NULL && message[0] != '\0')
-				pgcc_log(PGCC_ERROR, "could not load table %s: %s",
-				tab->table_name, message);
-			else
-				pgcc_log(PGCC_ERROR,
-					"could not load table %s: unexpected status %s\n",
-					tab->table_name, PQresStatus(PQresultStatus(tab->data)));
-		}
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			report_load_failure(tab, res);
 		else
-			build_hash_from_query_results(tab);
+			store_rows(tab, res);
+		PQclear(res);
 	}
+#endif
 
 	destroyPQExpBuffer(query);
 
+	if (tab->store != NULL)
+	{
+		pgcc_log(PGCC_DEBUG, "stored %d rows of table %s in %lu bytes\n",
+				 colstore_nrows(tab->store), tab->table_name,
+				 (unsigned long) colstore_memory(tab->store));
+
+		/* The next incremental run will want to know what's been deleted. */
+		if (incremental_path != NULL && !tab->sampled)
+			incremental_note_keys(tab);
+	}
+
 	/* This table is now loaded. */
 	tab->needs_load = false;
 
+	/* If there's nothing to check, loading it was all there was to do. */
+	if (tab->store != NULL && !tab->needs_check)
+		tab->check_complete = true;
+
 	/* Any other tables that neeed this table no longer do. */
 	for (i = 0; i < tab->num_needed_by; ++i)
 	{
@@ -887,100 +1353,228 @@ load_table(PGconn *conn, pg_catalog_table *tab)
 	}
 }
 
+/*
+ * Complain that we couldn't load a table.
+ */
+static void
+report_load_failure(pg_catalog_table *tab, PGresult *res)
+{
+	char	   *message = PQresultErrorMessage(res);
+
+	if (message != NULL && message[0] != '\0')
+		pgcc_log(PGCC_ERROR, "could not load table %s: %s",
+				 tab->table_name, message);
+	else
+		pgcc_log(PGCC_ERROR,
+				 "could not load table %s: unexpected status %s\n",
+				 tab->table_name, PQresStatus(PQresultStatus(res)));
+}
+
 /*
  * Perform integrity checks on a table.
  */
 static void
 check_table(PGconn *conn, pg_catalog_table *tab)
 {
-	int			i;
-	int			ntups;
-
 	/* Once we've tried to check the table, we shouldn't try again. */
 	tab->needs_check = false;
-	Assert(tab->data != NULL);
 
 	/*
 	 * If we weren't able to retrieve the table data, then we can't check the
 	 * table.  But there's no real need to log the error message, because
 	 * load_table() will have already done so.
 	 */
-#if PG_VERSION_NUM >= 90200
-	/* The table could be loaded either in single-row mode or bulk mode */
-	if (PQresultStatus(tab->data) != PGRES_TUPLES_OK &&
-		PQresultStatus(tab->data) != PGRES_SINGLE_TUPLE)
+	if (tab->store == NULL)
 		return;
-#else
-	if (PQresultStatus(tab->data) != PGRES_TUPLES_OK)
-		return;
-#endif
+
+	/* Log a message, if verbose mode is enabled. */
+	pgcc_log(PGCC_VERBOSE, "checking table %s (%d rows)\n", tab->table_name,
+			 colstore_nrows(tab->store));
+
+	check_rows(tab);
+	release_check_plan(tab);
+	tab->check_complete = true;
+}
+
+/*
+ * Check the rows currently in tab->store.  Tables loaded in single-row mode
+ * are checked this way a block at a time, as the rows arrive.
+ */
+static void
+check_rows(pg_catalog_table *tab)
+{
+	int			i;
+	int			start;
+	int			ntups = colstore_nrows(tab->store);
+	int			reported[CHECK_BLOCK_ROWS];
+	int			nreported;
+
+	/* Work out how to check each column, if we haven't already. */
+	if (!tab->plan_compiled)
+		compile_check_plan(tab);
 
 	/*
-	 * Log a message, if verbose mode is enabled. If the table was loaded in
-	 * single-row mode the caller takes care of logging the total row count.
+	 * Check the rows a block at a time, running each column's check over the
+	 * whole block before moving on to the next column, so that each check's
+	 * code and the reference data it consults stay in cache.  Reports are
+	 * held back until the end of the block and then printed in the same
+	 * order as if we'd gone row by row.
 	 */
-	ntups = PQntuples(tab->data);
+	for (start = 0; start < ntups; start += CHECK_BLOCK_ROWS)
+	{
+		int			end = Min(start + CHECK_BLOCK_ROWS, ntups);
 
-	if (PQresultStatus(tab->data) == PGRES_TUPLES_OK)
-		pgcc_log(PGCC_VERBOSE, "checking table %s (%d rows)\n", tab->table_name,
-			 ntups);
+		pgcc_begin_deferred_reports();
+		for (i = 0; i < tab->plan_length; ++i)
+		{
+			check_step *step = &tab->plan[i];
 
-	/* Loop over the rows and check them. */
-	for (i = 0; i < ntups; ++i)
+			pgcc_set_deferred_report_column(i);
+			step->kernel(step, tab, start, end);
+		}
+		nreported = pgcc_end_deferred_reports(reported);
+		tab->rows_reported += nreported;
+
+		/* Make sure the next incremental run looks at these rows again. */
+		if (tab->ctid_result_column != -1)
+			for (i = 0; i < nreported; ++i)
+				incremental_note_reported(tab, reported[i]);
+	}
+	tab->rows_checked += ntups;
+}
+
+/*
+ * Build the plan for checking a table: one step for each column to be
+ * checked, with its kernel and everything that kernel needs already looked
+ * up, so that checking a block of rows involves no decisions based on the
+ * catalog definitions.
+ *
+ * This must wait until the table and every table it depends on have been
+ * loaded, since the bound data includes result column numbers and
+ * referenced tables' hashes.
+ */
+static void
+compile_check_plan(pg_catalog_table *tab)
+{
+	pg_catalog_column *tabcol;
+	int			ncols = 0;
+
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+		ncols++;
+	tab->plan = pg_malloc((ncols + 1) * sizeof(check_step));
+	tab->plan_length = 0;
+
+	/* The table-level check, if any, comes first. */
+	if (tab->row_check_enabled)
 	{
-		pg_catalog_column *tabcol;
+		pg_catalog_check *check = tab->check;
+		check_step *step = &tab->plan[0];
+		bool		bound = false;
 
-		for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+		step->release = NULL;
+		step->tabcol = NULL;
+		switch (check->type)
 		{
-			pg_catalog_check *check;
+			case CHECK_DUPLICATE_OWNER:
+				bound = bind_duplicate_owner_check(tab, step);
+				break;
+			case CHECK_DEPENDENCY_GRAPH:
+				bound = bind_dependency_graph_check(tab, step);
+				break;
+			case CHECK_UNIQUE_KEY:
+				bound = bind_unique_key_check(tab, step);
+				break;
+			default:
+				break;
+		}
+		if (bound)
+			tab->plan_length++;
+	}
 
-			if (tabcol->checked != TRI_YES || tabcol->check == NULL)
-				continue;
-			check = tabcol->check;
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+	{
+		pg_catalog_check *check;
+		check_step *step = &tab->plan[tab->plan_length];
+		bool		bound = false;
 
-			switch (check->type)
-			{
-				case CHECK_ATTNUM:
-					check_attnum(tab, tabcol, i);
-					break;
-				case CHECK_OID_REFERENCE:
-				case CHECK_OID_VECTOR_REFERENCE:
-				case CHECK_OID_ARRAY_REFERENCE:
-					check_oid_reference(tab, tabcol, i);
-					break;
-				case CHECK_DEPENDENCY_CLASS_ID:
-					check_dependency_class_id(tab, tabcol, i);
-					break;
-				case CHECK_DEPENDENCY_ID:
-					check_dependency_id(tab, tabcol, i);
-					break;
-				case CHECK_DEPENDENCY_SUBID:
-					check_dependency_subid(tab, tabcol, i);
-					break;
-				case CHECK_RELNATTS:
-					check_relnatts(tab, tabcol, i);
-					break;
-			}
+		if (tabcol->checked != TRI_YES || tabcol->check == NULL)
+			continue;
+		check = tabcol->check;
+		step->release = NULL;
+		step->tabcol = tabcol;
+
+		switch (check->type)
+		{
+			case CHECK_ATTNUM:
+				bound = bind_attnum_check(tab, tabcol, step);
+				break;
+			case CHECK_OID_REFERENCE:
+			case CHECK_OID_VECTOR_REFERENCE:
+			case CHECK_OID_ARRAY_REFERENCE:
+				bound = bind_oid_reference_check(tab, tabcol, step);
+				break;
+			case CHECK_DEPENDENCY_CLASS_ID:
+				bound = bind_dependency_class_id_check(tab, tabcol, step);
+				break;
+			case CHECK_DEPENDENCY_ID:
+				bound = bind_dependency_id_check(tab, tabcol, step);
+				break;
+			case CHECK_DEPENDENCY_SUBID:
+				bound = bind_dependency_subid_check(tab, tabcol, step);
+				break;
+			case CHECK_RELNATTS:
+				bound = bind_relnatts_check(tab, tabcol, step);
+				break;
+			case CHECK_DUPLICATE_OWNER:
+			case CHECK_DEPENDENCY_GRAPH:
+			case CHECK_UNIQUE_KEY:
+				break;			/* not a column-level check */
 		}
+
+		/* Columns that turn out not to be checkable get no step. */
+		if (bound)
+			tab->plan_length++;
 	}
+
+	tab->plan_compiled = true;
 }
 
 /*
- * Build a hash table on the key columns of the catalog table contents.
+ * Let each step of a table's check plan free whatever it no longer needs
+ * once the table has been checked.  Most steps keep their state, since it
+ * holds the statistics reported at the end of the run.
  */
 static void
-build_hash_from_query_results(pg_catalog_table *tab)
+release_check_plan(pg_catalog_table *tab)
 {
 	int			i;
+
+	if (!tab->plan_compiled)
+		return;
+
+	for (i = 0; i < tab->plan_length; ++i)
+	{
+		check_step *step = &tab->plan[i];
+
+		if (step->release != NULL)
+			step->release(step);
+	}
+}
+
+/*
+ * Create an empty hash table on the key columns of tab->store, sized for the
+ * indicated number of rows.
+ */
+static void
+create_hash_for_table(pg_catalog_table *tab, int expected_rows)
+{
 	pg_catalog_column *tabcol;
-	pgrhash    *ht;
 	int			keycols[MAX_KEY_COLS];
 	int			nkeycols = 0;
-	int			ntups = PQntuples(tab->data);
 
 	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
 		if (tabcol->available && tabcol->is_key_column)
-			keycols[nkeycols++] = PQfnumber(tab->data, tabcol->name);
+			keycols[nkeycols++] = colstore_fnumber(tab->store, tabcol->name);
 
 	/*
 	 * Tables like pg_depend get loaded so that we can check them, but they
@@ -989,13 +1583,201 @@ build_hash_from_query_results(pg_catalog_table *tab)
 	if (nkeycols == 0)
 		return;
 
-	/* Create the hash table. */
-	ht = tab->ht = pgrhash_create(tab->data, nkeycols, keycols);
+	tab->ht = pgrhash_create(tab->store, expected_rows, nkeycols, keycols);
+}
 
+/*
+ * Add one row of tab->store to the table's hash, complaining if its key
+ * duplicates that of an earlier row.
+ */
+static void
+add_row_to_hash(pg_catalog_table *tab, int rownum)
+{
+	/* A run we're resuming reported these when it checked the table. */
+	if (pgrhash_insert(tab->ht, rownum) != -1 && !table_already_checked(tab))
+		pgcc_report(tab, NULL, rownum, "%s row duplicates existing key\n",
+					tab->table_name);
+}
+
+/*
+ * Replace a table's rows and hash with a set of its key OIDs, if that's all
+ * that remaining checks could need.
+ *
+ * That's the case once the table's own checks are done, if its only key
+ * column holds OIDs and no other table's checks examine its rows.  Tables
+ * loaded only because others refer to them, such as the catalogs pulled in
+ * by dependency checks, then cost a fraction of the memory.  We leave the
+ * table alone if any key isn't a well-formed OID, since a set of OIDs
+ * couldn't represent it.
+ */
+static void
+compact_table(pg_catalog_table *tab)
+{
+	pg_catalog_column *tabcol;
+	pg_catalog_column *keycol = NULL;
+	int			key_column;
+	int			ntups;
+	int			i;
+	uint32	   *oids;
+
+	if (tab->needs_check || tab->needs_rows || tab->ht == NULL)
+		return;
+
+	/* Find the key column, and make sure there's only one. */
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+	{
+		if (!tabcol->available || !tabcol->is_key_column)
+			continue;
+		if (keycol != NULL)
+			return;
+		keycol = tabcol;
+	}
+	if (keycol == NULL)
+		return;
+	key_column = colstore_fnumber(tab->store, keycol->name);
+	if (key_column == -1)
+		return;
+
+	ntups = colstore_nrows(tab->store);
+	oids = pg_malloc(Max(ntups, 1) * sizeof(uint32));
 	for (i = 0; i < ntups; i++)
-		if (pgrhash_insert(ht, i) != -1)
-			pgcc_report(tab, NULL, i, "%s row duplicates existing key\n",
-						tab->table_name);
+	{
+		if (!colstore_get_integer(tab->store, i, key_column, false, &oids[i]))
+		{
+			pg_free(oids);
+			return;
+		}
+	}
+
+	tab->oids = oidset_create(oids, ntups);
+	pg_free(oids);
+
+	pgcc_log(PGCC_DEBUG,
+			 "replaced %d rows of table %s (%lu bytes) with a set of %d OIDs (%lu bytes)\n",
+			 ntups, tab->table_name,
+			 (unsigned long) colstore_memory(tab->store),
+			 oidset_cardinality(tab->oids),
+			 (unsigned long) oidset_memory(tab->oids));
+
+	release_join_indexes(tab);
+	pgrhash_destroy(tab->ht);
+	tab->ht = NULL;
+	colstore_destroy(tab->store);
+	tab->store = NULL;
+	if (tab->sorted_oids != NULL)
+	{
+		pg_free(tab->sorted_oids);
+		tab->sorted_oids = NULL;
+	}
+}
+
+/*
+ * Could we check just some of this table's rows, rather than all of them?
+ * Only if nothing else refers to it, it has no table-level check, and every
+ * column check just looks for the objects the column refers to, so that each
+ * row can be checked on its own.
+ */
+bool
+table_checks_only_references(pg_catalog_table *tab)
+{
+	pg_catalog_column *tabcol;
+
+	if (tab->num_needed_by != 0 || tab->needs_rows || tab->row_check_enabled)
+		return false;
+
+	for (tabcol = tab->cols; tabcol->name != NULL; ++tabcol)
+	{
+		pg_catalog_check *check = tabcol->check;
+
+		if (tabcol->checked != TRI_YES || check == NULL)
+			continue;
+		switch (check->type)
+		{
+			case CHECK_OID_REFERENCE:
+			case CHECK_OID_VECTOR_REFERENCE:
+			case CHECK_OID_ARRAY_REFERENCE:
+			case CHECK_DEPENDENCY_CLASS_ID:
+			case CHECK_DEPENDENCY_ID:
+			case CHECK_DEPENDENCY_SUBID:
+				break;
+			default:
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Should we read only a sample of this table's rows?
+ *
+ * Only tables that nothing else refers to are sampled, since a reference
+ * into a sampled table would look dangling whenever the row it refers to
+ * wasn't picked.  A table-level check that looks at every row, such as the
+ * check of pg_depend as a graph, sees just the sample; it will find fewer
+ * duplicates or cycles than it would in the whole table, but none that
+ * aren't there.
+ */
+static bool
+table_is_sampled(pg_catalog_table *tab)
+{
+	return sample_percent < 100.0 && tab->num_needed_by == 0 &&
+		!tab->needs_rows;
+}
+
+/*
+ * Report how many of the sampled rows had inconsistencies, and an upper
+ * bound on the rate at which rows of the sampled tables as a whole have
+ * them.
+ */
+static void
+report_sample_bound(void)
+{
+	pg_catalog_table *tab;
+	long		nrows = 0;
+	long		nreported = 0;
+	int			ntables = 0;
+
+	for (tab = pg_catalog_tables; tab->table_name != NULL; ++tab)
+	{
+		if (!tab->sampled)
+			continue;
+		pgcc_log(PGCC_VERBOSE,
+				 "sampled %ld rows of table %s, %ld with inconsistencies\n",
+				 tab->rows_checked, tab->table_name, tab->rows_reported);
+		nrows += tab->rows_checked;
+		nreported += tab->rows_reported;
+		ntables++;
+	}
+
+	pgcc_log(PGCC_PROGRESS,
+			 "sampled %g%% of rows of %d tables with seed %u (%ld rows, %ld with inconsistencies)\n",
+			 sample_percent, ntables, sample_seed, nrows, nreported);
+	if (nrows > 0)
+		pgcc_log(PGCC_PROGRESS,
+				 "at %d%% confidence, at most %.3g%% of rows in sampled tables have inconsistencies\n",
+				 SAMPLE_CONFIDENCE_PERCENT,
+				 100.0 * rate_upper_bound(nreported, nrows));
+}
+
+/*
+ * Upper end of the Wilson score interval for the rate of rows with
+ * inconsistencies, having found nreported of them among nrows sampled.
+ * Unlike the textbook interval, it doesn't collapse to zero when nothing
+ * was found: it then comes to about z^2 / nrows.
+ */
+static double
+rate_upper_bound(long nreported, long nrows)
+{
+	double		z = SAMPLE_CONFIDENCE_Z;
+	double		n = nrows;
+	double		p = nreported / n;
+	double		center;
+	double		spread;
+
+	center = p + z * z / (2 * n);
+	spread = z * sqrt(p * (1 - p) / n + z * z / (4 * n * n));
+	return Min((center + spread) / (1 + z * z / n), 1.0);
 }
 
 /*
@@ -1029,8 +1811,42 @@ build_query_for_table(pg_catalog_table *tab)
 
 	Assert(index > 0);
 
+	/*
+	 * If this table could be checked incrementally next time, we'll need to
+	 * know which of its rows we reported on.
+	 */
+	if (table_supports_incremental(tab))
+	{
+		appendPQExpBuffer(query, ", ctid");
+		tab->ctid_result_column = index;
+	}
+
 	appendPQExpBuffer(query, " FROM pg_catalog.%s", tab->table_name);
 
+	/*
+	 * BERNOULLI picks each row independently, so the bound we report on the
+	 * rate of inconsistent rows holds; SYSTEM picks whole pages, and rows
+	 * inserted together, which are often broken together, would be sampled
+	 * together too.
+	 */
+	if (tab->sampled)
+		appendPQExpBuffer(query, " TABLESAMPLE BERNOULLI (%g) REPEATABLE (%u)",
+						  sample_percent, sample_seed);
+
+	/* Or only the rows that might have changed since the last run. */
+	if (tab->incremental)
+	{
+		char	   *filter;
+
+		if (since_last_run)
+			filter = build_ddl_log_filter(tab);
+		else
+			filter = build_incremental_filter(tab);
+
+		appendPQExpBuffer(query, " WHERE %s", filter);
+		pg_free(filter);
+	}
+
 	return query;
 }
 
@@ -1101,6 +1917,32 @@ add_table_dependency(pg_catalog_table *needs, pg_catalog_table *needed_by)
 	++needed_by->num_needed_by;
 }
 
+/*
+ * Indicate that a table no longer requires any other table to be loaded,
+ * because it won't be checked after all.
+ */
+void
+drop_table_dependencies(pg_catalog_table *needs)
+{
+	int			i;
+
+	for (i = 0; i < needs->num_needs; ++i)
+	{
+		pg_catalog_table *needed_by = needs->needs[i];
+		int			j,
+					k;
+
+		for (j = 0, k = 0; j < needed_by->num_needed_by; ++j)
+		{
+			needed_by->needed_by[k] = needed_by->needed_by[j];
+			if (needs != needed_by->needed_by[j])
+				++k;
+		}
+		needed_by->num_needed_by = k;
+	}
+	needs->num_needs = 0;
+}
+
 /*
  * Print a usage message and exit.
  */
@@ -1114,6 +1956,13 @@ usage(void)
 	printf("  -t, --table              check only columns in the named tables\n");
 	printf("  -T, --exclude-table      do NOT check the named tables\n");
 	printf("  -C, --exclude-column     do NOT check the named columns\n");
+	printf("  --sample=PERCENT         check only a sample of rows of unreferenced tables\n");
+	printf("  --sample-seed=SEED       seed for choosing the sample\n");
+	printf("  --incremental=STATEFILE  check only rows changed since the last run\n");
+	printf("  --install-ddl-log        install event triggers to log DDL, then exit\n");
+	printf("  --since-last-run         check only rows related to logged DDL\n");
+	printf("  --checkpoint=FILE        record progress in FILE as tables are checked\n");
+	printf("  --resume                 skip tables already checked according to FILE\n");
 	printf("  --select-from-relations  execute the SELECT on relations in the database\n");
 	printf("  --target-version=VERSION assume specified target version\n");
 	printf("  --enterprisedb           assume EnterpriseDB database\n");
@@ -14,8 +14,18 @@
 #include "compat.h"
 
 /* Forward declarations. */
+struct colstore;
+typedef struct colstore colstore;
 struct pgrhash;
 typedef struct pgrhash pgrhash;
+struct objaddr_index;
+typedef struct objaddr_index objaddr_index;
+struct oidset;
+typedef struct oidset oidset;
+struct depgraph;
+typedef struct depgraph depgraph;
+struct attribute_summary;
+typedef struct attribute_summary attribute_summary;
 struct pg_catalog_table;
 typedef struct pg_catalog_table pg_catalog_table;
 
@@ -38,6 +48,9 @@ typedef enum checktype
 	CHECK_DEPENDENCY_ID,
 	CHECK_DEPENDENCY_SUBID,
 	CHECK_RELNATTS,
+	CHECK_DUPLICATE_OWNER,
+	CHECK_DEPENDENCY_GRAPH,
+	CHECK_UNIQUE_KEY,
 }	checktype;
 
 /* Generic catalog check structure. */
@@ -54,6 +67,20 @@ typedef struct pg_catalog_check_oid
 	char	   *oid_references_table;
 }	pg_catalog_check_oid;
 
+/*
+ * Specialization of pg_catalog_check for a unique key other than the one we
+ * hash the table on.  Columns not available on the server being checked are
+ * left out of the key.
+ */
+#define MAX_UNIQUE_KEY_COLS		4
+
+typedef struct pg_catalog_check_unique
+{
+	checktype	type;
+	int			minimum_version;
+	char	   *columns[MAX_UNIQUE_KEY_COLS + 1];	/* NULL-terminated */
+}	pg_catalog_check_unique;
+
 
 /* Everything we need to check a catalog column. */
 typedef struct pg_catalog_column
@@ -74,28 +101,68 @@ typedef struct pg_catalog_column
 	bool		needed;
 	void	   *check_private;	/* workspace for individual checks */
 	int			result_column;	/* result column number */
+	pg_catalog_table *join_table;	/* table this column's join index is to */
+	int			join_requests;	/* # of checks that asked for it */
+	int		   *join_index;		/* referenced row for each row, if built */
 } pg_catalog_column;
 
+/*
+ * One step of a table's check plan: a kernel that checks a single column
+ * over a range of rows, with everything it needs already looked up.  The
+ * bind_*_check() functions fill these in once the table's data is loaded.
+ * A table-level check, which looks at whole rows, is a step with no column.
+ */
+typedef struct check_step check_step;
+typedef void (*check_kernel) (check_step *step, pg_catalog_table *tab,
+							  int start, int end);
+typedef void (*check_release) (check_step *step);
+
+struct check_step
+{
+	check_kernel kernel;
+	check_release release;		/* frees state when table is checked, or NULL */
+	pg_catalog_column *tabcol;	/* column to check, or NULL */
+	void	   *state;			/* check-specific bound data */
+};
+
 /* Everything we need to check an entire catalog table. */
 struct pg_catalog_table
 {
 	/* These columns are listed in definitions.c */
 	char	   *table_name;
 	pg_catalog_column *cols;
+	void	   *check;			/* table-level pg_catalog_check, if any */
 
 	/* These columns are populated at runtime. */
 	bool		available;		/* OK for this version? */
 	enum trivalue checked;
+	bool		row_check_enabled;	/* Run the table-level check? */
 	bool		needs_load;		/* Still needs to be loaded? */
 	bool		needs_check;	/* Still needs to be checked? */
-	PGresult   *data;			/* Table data. */
+	bool		needs_rows;		/* Rows needed by other tables' checks? */
+	bool		needs_all_rows; /* Table-level check needs every row? */
+	bool		check_complete; /* Checked (or loaded) without error? */
+	bool		sampled;		/* Reading only a sample of the rows? */
+	long		rows_checked;	/* # of rows checked */
+	long		rows_reported;	/* ... of which, how many had reports */
+	int			inconsistencies;	/* # of inconsistencies reported */
+	bool		incremental;	/* Reading only rows that might have changed? */
+	int			ctid_result_column;	/* Result column of ctid, or -1. */
+	int			estimated_rows; /* Row count estimate, or 0 if unknown. */
+	colstore   *store;			/* Table data, or NULL if unavailable. */
 	pgrhash    *ht;				/* Hash of table data. */
+	oidset	   *oids;			/* Key OIDs, if store and ht were discarded. */
+	uint32	   *sorted_oids;	/* Sorted key OIDs, for merge checks. */
+	int			num_sorted_oids;	/* # of entries in same. */
 	int			num_needs;		/* # of tables we depend on. */
 	int			num_needs_allocated;	/* Allocated slots for same. */
 	pg_catalog_table **needs;	/* Array of tables we depend on. */
 	int			num_needed_by;	/* # of tables depending on us. */
 	int			num_needed_by_allocated;		/* Allocated slots for same. */
 	pg_catalog_table **needed_by;		/* Array of tables depending on us. */
+	bool		plan_compiled;	/* Has the check plan been built? */
+	int			plan_length;	/* # of steps in check plan. */
+	check_step *plan;			/* Array of steps in check plan. */
 };
 
 /* Array of tables known to this tool. */
@@ -111,18 +178,28 @@ extern pg_catalog_table *find_table_by_name(char *table_name);
 extern pg_catalog_column *find_column_by_name(pg_catalog_table *, char *);
 extern void add_table_dependency(pg_catalog_table *needs,
 					 pg_catalog_table *needed_by);
+extern void drop_table_dependencies(pg_catalog_table *needs);
+extern bool table_checks_only_references(pg_catalog_table *tab);
 
 /* check_attribute.c */
 extern void prepare_to_check_attnum(pg_catalog_table *tab,
 						pg_catalog_column *tabcol);
-extern void check_attnum(pg_catalog_table *tab, pg_catalog_column *tabcol,
-			 int rownum);
+extern bool bind_attnum_check(pg_catalog_table *tab,
+				  pg_catalog_column *tabcol, check_step *step);
+extern void request_attribute_summary(void);
+extern attribute_summary *get_attribute_summary(void);
+extern bool attribute_summary_covers(attribute_summary *summary,
+						 int class_rownum, long relnatts);
+extern int attribute_summary_next_missing(attribute_summary *summary,
+							   int class_rownum, long relnatts, int attno);
+extern enum trivalue attribute_summary_contains(attribute_summary *summary,
+						   int class_rownum, long attnum);
 
 /* check_class.c */
 extern void prepare_to_check_relnatts(pg_catalog_table *tab,
 						  pg_catalog_column *tabcol);
-extern void check_relnatts(pg_catalog_table *tab, pg_catalog_column *tabcol,
-			   int rownum);
+extern bool bind_relnatts_check(pg_catalog_table *tab,
+					pg_catalog_column *tabcol, check_step *step);
 
 /* check_depend.c */
 extern void prepare_to_check_dependency_class_id(pg_catalog_table *tab,
@@ -131,23 +208,62 @@ extern void prepare_to_check_dependency_id(pg_catalog_table *tab,
 							   pg_catalog_column *tabcol);
 extern void prepare_to_check_dependency_subid(pg_catalog_table *tab,
 								  pg_catalog_column *tabcol);
-extern void check_dependency_class_id(pg_catalog_table *tab,
-						  pg_catalog_column *tabcol, int rownum);
-extern void check_dependency_id(pg_catalog_table *tab,
-					pg_catalog_column *tabcol, int rownum);
-extern void check_dependency_subid(pg_catalog_table *tab,
-					   pg_catalog_column *tabcol, int rownum);
+extern pg_catalog_column *find_dependency_class_column(pg_catalog_table *tab,
+							 pg_catalog_column *tabcol);
+extern pg_catalog_column *find_dependency_object_column(pg_catalog_table *tab,
+							  pg_catalog_column *tabcol);
+extern bool bind_dependency_class_id_check(pg_catalog_table *tab,
+							   pg_catalog_column *tabcol, check_step *step);
+extern bool bind_dependency_id_check(pg_catalog_table *tab,
+						 pg_catalog_column *tabcol, check_step *step);
+extern bool bind_dependency_subid_check(pg_catalog_table *tab,
+							pg_catalog_column *tabcol, check_step *step);
+extern void prepare_to_check_duplicate_owner(pg_catalog_table *tab);
+extern bool bind_duplicate_owner_check(pg_catalog_table *tab,
+						   check_step *step);
+extern void prepare_to_check_dependency_graph(pg_catalog_table *tab);
+extern bool bind_dependency_graph_check(pg_catalog_table *tab,
+							check_step *step);
+extern void report_dependency_stats(void);
+
+/* check_unique.c */
+extern void prepare_to_check_unique_key(pg_catalog_table *tab);
+extern bool bind_unique_key_check(pg_catalog_table *tab, check_step *step);
 
 /* check_oids.c */
 extern void prepare_to_check_oid_reference(pg_catalog_table *tab,
 							   pg_catalog_column *tabcol);
-extern void check_oid_reference(pg_catalog_table *tab,
-					pg_catalog_column *tabcol, int rownum);
+extern bool bind_oid_reference_check(pg_catalog_table *tab,
+						 pg_catalog_column *tabcol, check_step *step);
+extern void report_oid_reference_stats(pg_catalog_table *tab,
+						   pg_catalog_column *tabcol);
 
 /* select_from_relations.c */
 extern void prepare_to_select_from_relations(void);
 extern void perform_select_from_relations(PGconn *conn);
 
+/* checkpoint.c */
+extern void begin_checkpoints(PGconn *conn, char *path, bool resume);
+extern bool table_already_checked(pg_catalog_table *tab);
+extern void save_checkpoint(void);
+extern void finish_checkpoints(void);
+
+/* ddllog.c */
+extern void install_ddl_log(PGconn *conn);
+extern void begin_ddl_log_check(PGconn *conn);
+extern bool table_uses_ddl_log(pg_catalog_table *tab);
+extern char *build_ddl_log_filter(pg_catalog_table *tab);
+extern void finish_ddl_log_check(PGconn *conn);
+
+/* incremental.c */
+extern void begin_incremental_check(PGconn *conn, char *path);
+extern bool table_supports_incremental(pg_catalog_table *tab);
+extern bool table_is_incremental(pg_catalog_table *tab);
+extern char *build_incremental_filter(pg_catalog_table *tab);
+extern void incremental_note_keys(pg_catalog_table *tab);
+extern void incremental_note_reported(pg_catalog_table *tab, int rownum);
+extern void finish_incremental_check(void);
+
 /* log.c */
 typedef enum pgcc_severity
 {
@@ -181,6 +297,12 @@ pgcc_report(pg_catalog_table *tab, pg_catalog_column *tabcol,
 pg_attribute_printf(4, 5);
 #endif
 extern void pgcc_log_completion(void);
+extern void pgcc_begin_deferred_reports(void);
+extern void pgcc_set_deferred_report_column(int column);
+extern int	pgcc_end_deferred_reports(int *rows);
+extern bool pgcc_log_had_errors(void);
+extern bool pgcc_log_had_inconsistencies(void);
+extern void pgcc_log_add_inconsistencies(int ninconsistencies);
 
 #ifndef PG_USED_FOR_ASSERTS_ONLY
 #define PG_USED_FOR_ASSERTS_ONLY
@@ -189,8 +311,68 @@ extern void pgcc_log_completion(void);
 /* pgrhash.c */
 
 #define		MAX_KEY_COLS		10
-extern pgrhash *pgrhash_create(PGresult *result, int nkeycols, int *keycols);
+extern pgrhash *pgrhash_create(colstore *store, int expected_rows,
+			   int nkeycols, int *keycols);
+extern void pgrhash_destroy(pgrhash *ht);
 extern int	pgrhash_get(pgrhash *ht, char **keyvals);
+extern int	pgrhash_get_integer(pgrhash *ht, uint32 *key);
 extern int	pgrhash_insert(pgrhash *ht, int rownum);
+extern void pgrhash_report_stats(pgrhash *ht, const char *name);
+extern bool parse_integer_key(const char *s, bool is_signed, uint32 *result);
+extern bool parse_integer_key_len(const char *s, size_t len, bool is_signed,
+					  uint32 *result);
+
+/* colstore.c */
+extern colstore *colstore_create(PGresult *res, int expected_rows);
+extern void colstore_destroy(colstore *cs);
+extern void colstore_truncate(colstore *cs);
+extern void colstore_append(colstore *cs, PGresult *res);
+extern int	colstore_nrows(colstore *cs);
+extern int	colstore_fnumber(colstore *cs, const char *name);
+extern Oid	colstore_ftype(colstore *cs, int colno);
+extern char *colstore_getvalue(colstore *cs, int rownum, int colno);
+extern bool colstore_get_integer(colstore *cs, int rownum, int colno,
+					 bool is_signed, uint32 *result);
+extern uint32 colstore_get_code(colstore *cs, int rownum, int colno);
+extern Size colstore_memory(colstore *cs);
+
+/* depgraph.c */
+extern depgraph *depgraph_create(int expected_edges);
+extern void depgraph_add_edge(depgraph *graph, int source_classno,
+				  Oid source_objid, int target_classno, Oid target_objid,
+				  char label, int id);
+extern void depgraph_finish(depgraph *graph);
+extern void depgraph_destroy(depgraph *graph);
+extern int	depgraph_nnodes(depgraph *graph);
+extern void depgraph_node_address(depgraph *graph, int node, int *classno,
+					  Oid *objid);
+extern int depgraph_edges(depgraph *graph, int node, int **target,
+			   char **label, int **id);
+extern Size depgraph_memory(depgraph *graph);
+extern int *depgraph_components(depgraph *graph, const char *labels,
+					int **component_size);
+extern bool *depgraph_reaching(depgraph *graph, const char *labels,
+				  const bool *targets);
+
+/* joinidx.c */
+extern void request_join_index(pg_catalog_table *tab,
+				   pg_catalog_column *tabcol, pg_catalog_table *reftab);
+extern int *get_join_index(pg_catalog_table *tab, pg_catalog_column *tabcol);
+extern void release_join_indexes(pg_catalog_table *tab);
+
+/* oidset.c */
+extern oidset *oidset_create(uint32 *oids, int noids);
+extern bool oidset_contains(oidset *set, uint32 oid);
+extern int	oidset_cardinality(oidset *set);
+extern Size oidset_memory(oidset *set);
+extern void radix_sort_oids(uint32 *oids, int *rows, int noids);
+
+/* objaddr.c */
+extern objaddr_index *objaddr_index_create(int expected_entries);
+extern void objaddr_index_destroy(objaddr_index *idx);
+extern int	objaddr_index_insert(objaddr_index *idx, int classno, Oid objid,
+					 int rownum);
+extern int	objaddr_index_get(objaddr_index *idx, int classno, Oid objid);
+extern void objaddr_index_report_stats(objaddr_index *idx);
 
 #endif   /* PGCATCHECK_H */
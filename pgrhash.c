@@ -2,12 +2,32 @@
  *
  * pgrhash.c
  *
- * Simple hash table implementation for text data stored in a PGresult.
+ * Simple hash table implementation for the rows of a colstore.
  * The user can specify which columns are to serve as keys.  The code
  * is loosely based on the backend's dynahash.c, but is dramatically
  * simpler since we need only a small subset of the functionality offered
  * by that module.
  *
+ * Almost all of our keys are oid, int2 or int4 columns.  When every key
+ * column has one of those types, the table is "typed": each entry carries
+ * its key converted to 32-bit integers alongside the full hash value, so a
+ * probe is decided entirely within the entry and never has to go back to
+ * the stored rows.  Only the canonical text form of a number can match, so
+ * lookups behave exactly as the string comparison they replace.  Tables
+ * with any other kind of key compare the stored hash value first and only
+ * then fetch and compare the strings.
+ *
+ * When the table is keyed by a single column of type oid, rows whose OID
+ * falls below FirstNormalObjectId are not hashed at all.  Those OIDs are
+ * assigned densely at initdb time and account for the bulk of the lookups
+ * we do (builtin types, functions, namespaces, operators), so we keep a
+ * bitmap with a side array of row numbers for that range, which makes the
+ * common lookup a single bit test.
+ *
+ * When debug output is enabled (-v -v), each table also counts its lookups
+ * and the work done to answer them, so that pgrhash_report_stats() can
+ * show how well the hash function distributes the keys of a given catalog.
+ *
  *-------------------------------------------------------------------------
  */
 
@@ -19,65 +39,181 @@
 #include "port/pg_bitutils.h"
 #endif
 
+#if PG_VERSION_NUM >= 110000
+#include "catalog/pg_type_d.h"
+#else
+#include "catalog/pg_type.h"
+#endif
+
+/*
+ * OIDs below this value are indexed by the dense bitmap rather than the hash
+ * table.  This is FirstNormalObjectId from access/transam.h, which has had
+ * the same value in every server version we support.
+ */
+#define DENSE_OID_LIMIT		16384
+#define DENSE_OID_WORDS		(DENSE_OID_LIMIT / 64)
+
+/* Number of entries carved out of each chunk of entry storage. */
+#define ENTRIES_PER_CHUNK	1024
+
 typedef struct pgrhash_entry
 {
 	struct pgrhash_entry *next; /* link to next entry in same bucket */
 	uint32		hashvalue;		/* hash function result for this entry */
-	int			rownum;			/* row number of data in PGresult */
+	int			rownum;			/* row number of data in colstore */
+	uint32		key[FLEXIBLE_ARRAY_MEMBER]; /* typed key, if any */
 } pgrhash_entry;
 
+typedef struct pgrhash_chunk
+{
+	struct pgrhash_chunk *next; /* previously allocated chunk */
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} pgrhash_chunk;
+
 struct pgrhash
 {
-	PGresult   *res;			/* pointer to PGresult data */
+	colstore   *store;			/* the rows being indexed */
 	int			nkeycols;		/* number of key columns */
 	int			keycols[MAX_KEY_COLS];	/* array of key column indices */
+	bool		typed;			/* entries carry integer keys? */
+	bool		key_signed[MAX_KEY_COLS];	/* int2/int4 rather than oid */
 	unsigned	nbuckets;		/* number of buckets */
+	unsigned	nentries;		/* number of entries in buckets */
 	pgrhash_entry **bucket;		/* pointer to hash entries */
+	Size		entry_size;		/* bytes per entry, including key */
+	pgrhash_chunk *chunks;		/* storage for entries */
+	int			chunk_free;		/* unused entries left in current chunk */
+	uint64	   *dense_bits;		/* low OIDs present, or NULL if not oid-keyed */
+	int		   *dense_rownum;	/* row number for each bit in dense_bits */
+	unsigned	ndense;			/* number of entries in dense_bits */
+
+	/* Statistics, maintained only if collect_stats is set. */
+	bool		collect_stats;
+	uint64		lookups;		/* calls to pgrhash_get() */
+	uint64		hits;			/* ... that found a match */
+	uint64		dense_lookups;	/* ... answered from the dense index */
+	uint64		probes;			/* chain entries visited by pgrhash_get() */
+	uint64		compares;		/* strings compared by pgrhash_get() */
 };
 
 static uint32 string_hash_sdbm(const char *key);
-static bool pgrhash_compare(pgrhash *ht, int rownum, char **keyvals);
+static uint32 hash_key_strings(pgrhash *ht, char **keyvals);
+static uint32 hash_key_words(pgrhash *ht, uint32 *key);
+static bool parse_key_words(pgrhash *ht, char **keyvals, uint32 *key);
+static bool fetch_key_words(pgrhash *ht, int rownum, uint32 *key);
+static int	pgrhash_get_words(pgrhash *ht, uint32 *key);
+static int	pgrhash_search(pgrhash *ht, uint32 hashvalue, char **keyvals,
+			   uint32 *key);
+static bool pgrhash_compare(pgrhash *ht, pgrhash_entry *entry,
+				uint32 hashvalue, char **keyvals, uint32 *key,
+				uint64 *compares);
+static pgrhash_entry *pgrhash_alloc_entry(pgrhash *ht);
+static void pgrhash_link_entry(pgrhash *ht, pgrhash_entry *entry);
+static void pgrhash_grow(pgrhash *ht);
+static void pgrhash_untype(pgrhash *ht);
 
 /*
- * Create a new hash table for given result set, keyed by the indicate
+ * Create a new hash table for given column store, keyed by the indicate
  * column indexes, but do not populate it.	pgrhash_insert() should
- * be called separately for each row of the result set to actually
+ * be called separately for each row of the store to actually
  * insert the rows.
+ *
+ * expected_rows is only a sizing hint.  The store may still be growing
+ * while rows are inserted, and the table is enlarged as needed.
  */
 pgrhash *
-pgrhash_create(PGresult *result, int nkeycols, int *keycols)
+pgrhash_create(colstore *store, int expected_rows, int nkeycols,
+			   int *keycols)
 {
 	unsigned	bucket_shift;
 	pgrhash    *ht;
-	int ntuples;
+	int			i;
 
 	Assert(nkeycols >= 1 && nkeycols <= MAX_KEY_COLS);
 
-	ntuples = PQntuples(result);
+	if (expected_rows < 0)
+		expected_rows = 0;
 
 #if PG_VERSION_NUM >= 150000
-	if (ntuples == 0)
+	if (expected_rows == 0)
 		bucket_shift = 0;
 	else
-		bucket_shift = pg_leftmost_one_pos32(ntuples) + 1;
+		bucket_shift = pg_leftmost_one_pos32(expected_rows) + 1;
 #else
-	bucket_shift = fls(ntuples);
+	bucket_shift = fls(expected_rows);
 #endif
 
 	if (bucket_shift >= sizeof(unsigned) * BITS_PER_BYTE)
 		pgcc_log(PGCC_FATAL, "too many tuples");
 
 	ht = (pgrhash *) pg_malloc(sizeof(pgrhash));
-	ht->res = result;
+	ht->store = store;
 	ht->nbuckets = ((unsigned) 1) << bucket_shift;
+	ht->nentries = 0;
+	ht->ndense = 0;
+	ht->chunks = NULL;
+	ht->chunk_free = 0;
+	ht->collect_stats = (verbose >= 2);
+	ht->lookups = 0;
+	ht->hits = 0;
+	ht->dense_lookups = 0;
+	ht->probes = 0;
+	ht->compares = 0;
 	ht->bucket = (pgrhash_entry **)
 		pg_malloc0(ht->nbuckets * sizeof(pgrhash_entry *));
 	ht->nkeycols = nkeycols;
 	memcpy(ht->keycols, keycols, sizeof(int) * nkeycols);
 
+	/* Decide whether we can store the key in integer form. */
+	ht->typed = true;
+	for (i = 0; i < nkeycols; i++)
+	{
+		Oid			typid = colstore_ftype(store, keycols[i]);
+
+		ht->key_signed[i] = (typid == INT2OID || typid == INT4OID);
+		if (typid != OIDOID && !ht->key_signed[i])
+			ht->typed = false;
+	}
+	ht->entry_size = MAXALIGN(offsetof(pgrhash_entry, key) +
+							  (ht->typed ? nkeycols * sizeof(uint32) : 0));
+
+	/* Set up the dense index if the only key column is an OID. */
+	if (ht->typed && nkeycols == 1 && !ht->key_signed[0])
+	{
+		ht->dense_bits = pg_malloc0(DENSE_OID_WORDS * sizeof(uint64));
+		ht->dense_rownum = pg_malloc(DENSE_OID_LIMIT * sizeof(int));
+	}
+	else
+	{
+		ht->dense_bits = NULL;
+		ht->dense_rownum = NULL;
+	}
+
 	return ht;
 }
 
+/*
+ * Free a hash table.  The underlying colstore is not affected.
+ */
+void
+pgrhash_destroy(pgrhash *ht)
+{
+	while (ht->chunks != NULL)
+	{
+		pgrhash_chunk *next = ht->chunks->next;
+
+		pg_free(ht->chunks);
+		ht->chunks = next;
+	}
+	pg_free(ht->bucket);
+	if (ht->dense_bits != NULL)
+	{
+		pg_free(ht->dense_bits);
+		pg_free(ht->dense_rownum);
+	}
+	pg_free(ht);
+}
+
 /*
  * Search a result-set hash table for a row matching a given set of key values.
  *
@@ -86,19 +222,113 @@ pgrhash_create(PGresult *result, int nkeycols, int *keycols)
 int
 pgrhash_get(pgrhash *ht, char **keyvals)
 {
+	uint32		key[MAX_KEY_COLS];
+
+	if (ht->typed)
+	{
+		/*
+		 * A value that isn't the canonical text form of a number can't be
+		 * equal to any of the keys we stored, all of which are.
+		 */
+		if (!parse_key_words(ht, keyvals, key))
+		{
+			if (ht->collect_stats)
+				ht->lookups++;
+			return -1;
+		}
+		return pgrhash_get_words(ht, key);
+	}
+
+	return pgrhash_search(ht, hash_key_strings(ht, keyvals), keyvals, NULL);
+}
+
+/*
+ * Search for a row whose key, parsed as parse_integer_key() would parse each
+ * column, matches the given integers.  This spares callers that already have
+ * the key in integer form the trouble of formatting it, and, for a typed
+ * table, spares us the trouble of parsing it.
+ */
+int
+pgrhash_get_integer(pgrhash *ht, uint32 *key)
+{
+	char		buf[MAX_KEY_COLS][12];
+	char	   *keyvals[MAX_KEY_COLS];
 	int			i;
-	uint32		hashvalue = 0;
-	pgrhash_entry *bucket;
+
+	if (ht->typed)
+		return pgrhash_get_words(ht, key);
 
 	for (i = 0; i < ht->nkeycols; i++)
-		hashvalue ^= string_hash_sdbm(keyvals[i]);
+	{
+		if (ht->key_signed[i])
+			snprintf(buf[i], sizeof(buf[i]), "%d", (int) (int32) key[i]);
+		else
+			snprintf(buf[i], sizeof(buf[i]), "%u", key[i]);
+		keyvals[i] = buf[i];
+	}
+	return pgrhash_get(ht, keyvals);
+}
+
+/*
+ * Look up an integer key in a typed table.
+ */
+static int
+pgrhash_get_words(pgrhash *ht, uint32 *key)
+{
+	int			result = -1;
+
+	/* Low OIDs live only in the dense index. */
+	if (ht->dense_bits != NULL && key[0] < DENSE_OID_LIMIT)
+	{
+		if ((ht->dense_bits[key[0] / 64] &
+			 (UINT64CONST(1) << (key[0] % 64))) != 0)
+			result = ht->dense_rownum[key[0]];
+		if (ht->collect_stats)
+		{
+			ht->lookups++;
+			ht->dense_lookups++;
+			if (result != -1)
+				ht->hits++;
+		}
+		return result;
+	}
+
+	return pgrhash_search(ht, hash_key_words(ht, key), NULL, key);
+}
+
+/*
+ * Search the bucket for a hash value for a matching entry, given the key in
+ * text form for an untyped table or in integer form for a typed one.
+ */
+static int
+pgrhash_search(pgrhash *ht, uint32 hashvalue, char **keyvals, uint32 *key)
+{
+	pgrhash_entry *bucket;
+	uint64		probes = 0;
+	uint64		compares = 0;
+	int			result = -1;
 
 	for (bucket = ht->bucket[hashvalue & (ht->nbuckets - 1)];
 		 bucket != NULL; bucket = bucket->next)
-		if (pgrhash_compare(ht, bucket->rownum, keyvals))
-			return bucket->rownum;
+	{
+		probes++;
+		if (pgrhash_compare(ht, bucket, hashvalue, keyvals, key, &compares))
+		{
+			result = bucket->rownum;
+			break;
+		}
+	}
 
-	return -1;
+	if (ht->collect_stats)
+	{
+		ht->lookups++;
+		ht->probes += probes;
+		ht->compares += compares;
+		if (result != -1)
+			ht->hits++;
+	}
+
+	return result;
 }
 
 /*
@@ -115,35 +345,260 @@ pgrhash_get(pgrhash *ht, char **keyvals)
 int
 pgrhash_insert(pgrhash *ht, int rownum)
 {
-	unsigned	bucket_number;
 	int			i;
-	unsigned	hashvalue = 0;
+	uint32		hashvalue;
+	uint32		key[MAX_KEY_COLS];
 	char	   *keyvals[MAX_KEY_COLS];
 	pgrhash_entry *bucket;
 	pgrhash_entry *entry;
 
-	for (i = 0; i < ht->nkeycols; i++)
+	/*
+	 * The server always sends integers in canonical form, so this can only
+	 * fail if a key column is null.  Such a key still has to be found by a
+	 * lookup for the empty string, so we give up on integer keys.
+	 */
+	if (ht->typed && !fetch_key_words(ht, rownum, key))
+		pgrhash_untype(ht);
+
+	if (!ht->typed)
+		for (i = 0; i < ht->nkeycols; i++)
+			keyvals[i] = colstore_getvalue(ht->store, rownum,
+										   ht->keycols[i]);
+
+	if (ht->typed)
 	{
-		keyvals[i] = PQgetvalue(ht->res, rownum, ht->keycols[i]);
-		hashvalue ^= string_hash_sdbm(keyvals[i]);
+		/* Low OIDs go into the dense index instead of the hash table. */
+		if (ht->dense_bits != NULL && key[0] < DENSE_OID_LIMIT)
+		{
+			uint64		bit = UINT64CONST(1) << (key[0] % 64);
+
+			if ((ht->dense_bits[key[0] / 64] & bit) != 0)
+				return ht->dense_rownum[key[0]];
+			ht->dense_bits[key[0] / 64] |= bit;
+			ht->dense_rownum[key[0]] = rownum;
+			ht->ndense++;
+			return -1;
+		}
+
+		hashvalue = hash_key_words(ht, key);
 	}
+	else
+		hashvalue = hash_key_strings(ht, keyvals);
 
 	/* Check for a conflicting entry already present in the table. */
-	bucket_number = hashvalue & (ht->nbuckets - 1);
-	for (bucket = ht->bucket[bucket_number];
+	for (bucket = ht->bucket[hashvalue & (ht->nbuckets - 1)];
 		 bucket != NULL; bucket = bucket->next)
-		if (pgrhash_compare(ht, bucket->rownum, keyvals))
+		if (pgrhash_compare(ht, bucket, hashvalue, keyvals, key, NULL))
 			return bucket->rownum;
 
 	/* Insert the new entry. */
-	entry = pg_malloc(sizeof(pgrhash_entry));
-	entry->next = ht->bucket[bucket_number];
+	entry = pgrhash_alloc_entry(ht);
+	entry->hashvalue = hashvalue;
 	entry->rownum = rownum;
-	ht->bucket[bucket_number] = entry;
+	if (ht->typed)
+		memcpy(entry->key, key, ht->nkeycols * sizeof(uint32));
+	pgrhash_link_entry(ht, entry);
 
 	return -1;
 }
 
+/*
+ * Allocate space for a new entry.
+ *
+ * Entries are carved out of large chunks, both to avoid per-allocation
+ * overhead and so that entries inserted together stay close in memory.
+ */
+static pgrhash_entry *
+pgrhash_alloc_entry(pgrhash *ht)
+{
+	if (ht->chunk_free == 0)
+	{
+		pgrhash_chunk *chunk;
+
+		chunk = pg_malloc(offsetof(pgrhash_chunk, data) +
+						  ht->entry_size * ENTRIES_PER_CHUNK);
+		chunk->next = ht->chunks;
+		ht->chunks = chunk;
+		ht->chunk_free = ENTRIES_PER_CHUNK;
+	}
+
+	ht->chunk_free--;
+	return (pgrhash_entry *)
+		(ht->chunks->data + ht->entry_size * ht->chunk_free);
+}
+
+/*
+ * Add an entry whose hash value has been set to the appropriate bucket.
+ */
+static void
+pgrhash_link_entry(pgrhash *ht, pgrhash_entry *entry)
+{
+	unsigned	bucket_number = entry->hashvalue & (ht->nbuckets - 1);
+
+	entry->next = ht->bucket[bucket_number];
+	ht->bucket[bucket_number] = entry;
+
+	/* Keep the average chain length at or below one. */
+	if (++ht->nentries > ht->nbuckets)
+		pgrhash_grow(ht);
+}
+
+/*
+ * Double the number of buckets, redistributing the existing entries.
+ *
+ * This is needed when the table was created before the final size of the
+ * result set was known, as when rows are inserted while still streaming in
+ * from the server.
+ */
+static void
+pgrhash_grow(pgrhash *ht)
+{
+	unsigned	old_nbuckets = ht->nbuckets;
+	pgrhash_entry **old_bucket = ht->bucket;
+	unsigned	i;
+
+	if (old_nbuckets >= ((unsigned) 1) << (sizeof(unsigned) * BITS_PER_BYTE - 1))
+		pgcc_log(PGCC_FATAL, "too many tuples");
+
+	ht->nbuckets = old_nbuckets * 2;
+	ht->bucket = (pgrhash_entry **)
+		pg_malloc0(ht->nbuckets * sizeof(pgrhash_entry *));
+
+	for (i = 0; i < old_nbuckets; i++)
+	{
+		pgrhash_entry *entry = old_bucket[i];
+
+		while (entry != NULL)
+		{
+			pgrhash_entry *next = entry->next;
+			unsigned	bucket_number;
+
+			bucket_number = entry->hashvalue & (ht->nbuckets - 1);
+			entry->next = ht->bucket[bucket_number];
+			ht->bucket[bucket_number] = entry;
+			entry = next;
+		}
+	}
+
+	pg_free(old_bucket);
+}
+
+/*
+ * Switch a typed table over to comparing keys as strings.
+ *
+ * Every existing entry, including those in the dense index, is rehashed from
+ * the text form of its key.  Entry storage keeps its original size, since the
+ * entries already allocated can't be moved.
+ */
+static void
+pgrhash_untype(pgrhash *ht)
+{
+	unsigned	old_nbuckets = ht->nbuckets;
+	pgrhash_entry **old_bucket = ht->bucket;
+	unsigned	i;
+
+	ht->typed = false;
+	ht->bucket = (pgrhash_entry **)
+		pg_malloc0(ht->nbuckets * sizeof(pgrhash_entry *));
+	ht->nentries = 0;
+
+	for (i = 0; i < old_nbuckets; i++)
+	{
+		pgrhash_entry *entry = old_bucket[i];
+
+		while (entry != NULL)
+		{
+			pgrhash_entry *next = entry->next;
+			char	   *keyvals[MAX_KEY_COLS];
+			int			k;
+
+			for (k = 0; k < ht->nkeycols; k++)
+				keyvals[k] = colstore_getvalue(ht->store, entry->rownum,
+											   ht->keycols[k]);
+			entry->hashvalue = hash_key_strings(ht, keyvals);
+			pgrhash_link_entry(ht, entry);
+			entry = next;
+		}
+	}
+	pg_free(old_bucket);
+
+	if (ht->dense_bits != NULL)
+	{
+		uint32		oid;
+
+		for (oid = 0; oid < DENSE_OID_LIMIT; oid++)
+		{
+			pgrhash_entry *entry;
+			char	   *keyval;
+
+			if ((ht->dense_bits[oid / 64] & (UINT64CONST(1) << (oid % 64))) == 0)
+				continue;
+			entry = pgrhash_alloc_entry(ht);
+			entry->rownum = ht->dense_rownum[oid];
+			keyval = colstore_getvalue(ht->store, entry->rownum,
+									   ht->keycols[0]);
+			entry->hashvalue = hash_key_strings(ht, &keyval);
+			pgrhash_link_entry(ht, entry);
+		}
+		pg_free(ht->dense_bits);
+		pg_free(ht->dense_rownum);
+		ht->dense_bits = NULL;
+		ht->dense_rownum = NULL;
+		ht->ndense = 0;
+	}
+}
+
+/*
+ * Report statistics for a hash table at PGCC_DEBUG level.
+ *
+ * The first line is meant for humans.  The second carries the same data,
+ * and more, as space-separated key=value pairs with a fixed "hashstats:"
+ * prefix, so that it can be extracted from the output of many runs and
+ * compared mechanically.
+ */
+void
+pgrhash_report_stats(pgrhash *ht, const char *name)
+{
+#define CHAIN_HISTOGRAM_SIZE	5
+	unsigned	chains[CHAIN_HISTOGRAM_SIZE];
+	unsigned	longest = 0;
+	unsigned	i;
+	uint64		hashed_lookups;
+
+	if (!ht->collect_stats)
+		return;
+
+	/* Compute the chain-length distribution. */
+	memset(chains, 0, sizeof(chains));
+	for (i = 0; i < ht->nbuckets; i++)
+	{
+		pgrhash_entry *entry;
+		unsigned	len = 0;
+
+		for (entry = ht->bucket[i]; entry != NULL; entry = entry->next)
+			len++;
+		if (len > longest)
+			longest = len;
+		chains[Min(len, CHAIN_HISTOGRAM_SIZE - 1)]++;
+	}
+	hashed_lookups = ht->lookups - ht->dense_lookups;
+
+	pgcc_log(PGCC_DEBUG,
+			 "hash table for %s: %u buckets, %u hashed entries, %u dense entries, load factor %.2f, longest chain %u, %.1f%% of lookups found a match\n",
+			 name, ht->nbuckets, ht->nentries, ht->ndense,
+			 (double) ht->nentries / ht->nbuckets, longest,
+			 ht->lookups == 0 ? 0.0 : 100.0 * ht->hits / ht->lookups);
+	pgcc_log(PGCC_DEBUG,
+			 "hashstats: table=%s typed=%d buckets=%u entries=%u dense_entries=%u max_chain=%u chain0=%u chain1=%u chain2=%u chain3=%u chain4plus=%u lookups=" UINT64_FORMAT " hits=" UINT64_FORMAT " dense_lookups=" UINT64_FORMAT " probes=" UINT64_FORMAT " compares=" UINT64_FORMAT " probes_per_lookup=%.3f compares_per_lookup=%.3f\n",
+			 name, ht->typed ? 1 : 0, ht->nbuckets, ht->nentries,
+			 ht->ndense, longest,
+			 chains[0], chains[1], chains[2], chains[3], chains[4],
+			 ht->lookups, ht->hits, ht->dense_lookups, ht->probes,
+			 ht->compares,
+			 hashed_lookups == 0 ? 0.0 : (double) ht->probes / hashed_lookups,
+			 hashed_lookups == 0 ? 0.0 : (double) ht->compares / hashed_lookups);
+}
+
 /*
  * Simple string hash function from http://www.cse.yorku.ca/~oz/hash.html
  *
@@ -165,21 +620,229 @@ string_hash_sdbm(const char *key)
 }
 
 /*
- * Test whether the given row number is match for the supplied keys.
+ * Combine the hashes of the key columns for an untyped table.
+ *
+ * Simply XORing the per-column hashes together would make keys such as
+ * (1, 2) and (2, 1) collide, so mix each one in instead.
+ */
+static uint32
+hash_key_strings(pgrhash *ht, char **keyvals)
+{
+	uint32		hashvalue = 0;
+	int			i;
+
+	for (i = 0; i < ht->nkeycols; i++)
+		hashvalue ^= string_hash_sdbm(keyvals[i]) + 0x9e3779b9 +
+			(hashvalue << 6) + (hashvalue >> 2);
+
+	return hashvalue;
+}
+
+/*
+ * Hash an integer key for a typed table.
+ *
+ * Each word is put through the finalizer from MurmurHash3 before being
+ * combined, because catalog OIDs are mostly consecutive and the bucket
+ * number is taken from the low-order bits.
+ */
+static uint32
+hash_key_words(pgrhash *ht, uint32 *key)
+{
+	uint32		hashvalue = 0;
+	int			i;
+
+	for (i = 0; i < ht->nkeycols; i++)
+	{
+		uint32		h = key[i];
+
+		h ^= h >> 16;
+		h *= 0x85ebca6b;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35;
+		h ^= h >> 16;
+		hashvalue ^= h + 0x9e3779b9 + (hashvalue << 6) + (hashvalue >> 2);
+	}
+
+	return hashvalue;
+}
+
+/*
+ * Convert a set of key values to integer form, for a typed table.
+ *
+ * Returns false if any value isn't the canonical text form of a number of
+ * the column's type.
  */
 static bool
-pgrhash_compare(pgrhash *ht, int rownum, char **keyvals)
+parse_key_words(pgrhash *ht, char **keyvals, uint32 *key)
 {
 	int			i;
-	char	   *keycol;
-	char	   *keyval;
+
+	for (i = 0; i < ht->nkeycols; i++)
+		if (!parse_integer_key(keyvals[i], ht->key_signed[i], &key[i]))
+			return false;
+
+	return true;
+}
+
+/*
+ * Fetch the key of a stored row in integer form, for a typed table.
+ *
+ * Returns false if any value isn't the canonical text form of a number of
+ * the column's type.
+ */
+static bool
+fetch_key_words(pgrhash *ht, int rownum, uint32 *key)
+{
+	int			i;
+
+	for (i = 0; i < ht->nkeycols; i++)
+		if (!colstore_get_integer(ht->store, rownum, ht->keycols[i],
+								  ht->key_signed[i], &key[i]))
+			return false;
+
+	return true;
+}
+
+/*
+ * Parse the canonical text form of an oid (if is_signed is false) or of an
+ * int2 or int4 (if it is true), as produced by the server's output
+ * functions.  Leading zeroes, signs other than a minus on a non-zero value,
+ * white space, and out-of-range values are all rejected, so that two strings
+ * parse to the same result only if they are identical.
+ *
+ * This is exported so that other modules that index integer keys can make
+ * the same guarantee.
+ */
+bool
+parse_integer_key(const char *s, bool is_signed, uint32 *result)
+{
+	return parse_integer_key_len(s, strlen(s), is_signed, result);
+}
+
+/*
+ * As parse_integer_key(), for a string whose length is already known, as it
+ * is for a value in a PGresult.
+ *
+ * This is where nearly all of the text we read from the server gets turned
+ * into numbers, so rather than going a digit at a time, we convert the last
+ * (up to) eight digits all at once with SWAR arithmetic: they're loaded into
+ * a 64-bit word, checked to be digits with two masks, and combined pairwise
+ * in three multiply-and-shift steps.  An OID has at most ten digits, so at
+ * most two are left over for the ordinary loop.
+ */
+bool
+parse_integer_key_len(const char *s, size_t len, bool is_signed,
+					  uint32 *result)
+{
+	bool		negative = false;
+	uint64		limit = is_signed ? PG_INT32_MAX : PG_UINT32_MAX;
+	uint64		val = 0;
+	uint64		word = 0;
+	size_t		nhigh;
+	size_t		pad;
+	size_t		i;
+
+	if (is_signed && len > 0 && *s == '-')
+	{
+		negative = true;
+		limit = (uint64) PG_INT32_MAX + 1;
+		s++;
+		len--;
+	}
+
+	if (len == 0)
+		return false;
+	if (*s == '0')
+	{
+		*result = 0;
+		return len == 1 && !negative;
+	}
+
+	/* Ten digits is enough for any 32-bit value. */
+	if (len > 10)
+		return false;
+
+	/* Leading digits beyond the last eight, if any, go the slow way. */
+	nhigh = len > 8 ? len - 8 : 0;
+	for (i = 0; i < nhigh; i++)
+	{
+		if (s[i] < '0' || s[i] > '9')
+			return false;
+		val = val * 10 + (s[i] - '0');
+	}
+
+	/*
+	 * Load the remaining digits so that the first is in the lowest-order
+	 * byte, padding on the left with '0' characters.  Building the word a
+	 * byte at a time keeps this independent of the machine's byte order.
+	 */
+	pad = 8 - (len - nhigh);
+	for (i = 0; i < 8; i++)
+	{
+		uint64		c = i < pad ? '0' : (unsigned char) s[nhigh + i - pad];
+
+		word |= c << (8 * i);
+	}
+
+	/*
+	 * Every byte must be '0' through '9': its high nibble must be 3, and
+	 * must still be 3 after adding 6, which pushes ':' through '?' over.
+	 */
+	if ((word & UINT64CONST(0xF0F0F0F0F0F0F0F0)) !=
+		UINT64CONST(0x3030303030303030) ||
+		((word + UINT64CONST(0x0606060606060606)) &
+		 UINT64CONST(0xF0F0F0F0F0F0F0F0)) !=
+		UINT64CONST(0x3030303030303030))
+		return false;
+
+	/* Combine adjacent digits, then pairs, then groups of four. */
+	word -= UINT64CONST(0x3030303030303030);
+	word = (word * 10 + (word >> 8)) & UINT64CONST(0x00FF00FF00FF00FF);
+	word = (word * 100 + (word >> 16)) & UINT64CONST(0x0000FFFF0000FFFF);
+	word = (word * 10000 + (word >> 32)) & UINT64CONST(0x00000000FFFFFFFF);
+
+	val = val * 100000000 + word;
+	if (val > limit)
+		return false;
+
+	*result = negative ? (uint32) (-(int64) val) : (uint32) val;
+	return true;
+}
+
+/*
+ * Test whether the given entry is a match for the supplied keys.
+ *
+ * For a typed table, key holds the keys in integer form and the comparison
+ * never leaves the entry.  Otherwise, the stored hash value lets us reject
+ * most non-matching entries before fetching their keys from the store;
+ * in that case, if compares is not NULL, it is incremented once per string
+ * compared.
+ */
+static bool
+pgrhash_compare(pgrhash *ht, pgrhash_entry *entry, uint32 hashvalue,
+				char **keyvals, uint32 *key, uint64 *compares)
+{
+	int			i;
+
+	if (entry->hashvalue != hashvalue)
+		return false;
+
+	if (ht->typed)
+	{
+		for (i = 0; i < ht->nkeycols; i++)
+			if (entry->key[i] != key[i])
+				return false;
+		return true;
+	}
 
 	for (i = 0; i < ht->nkeycols; i++)
 	{
-		keycol = PQgetvalue(ht->res, rownum, ht->keycols[i]);
-		keyval = keyvals[i];
+		char	   *keycol = colstore_getvalue(ht->store, entry->rownum,
+											   ht->keycols[i]);
 
-		if (strcmp(keycol, keyval) != 0)
+		if (compares != NULL)
+			(*compares)++;
+		if (strcmp(keycol, keyvals[i]) != 0)
 			return false;
 	}
 
@@ -28,12 +28,18 @@ prepare_to_select_from_relations(void)
 	pg_class->needs_load = true;
 	pg_namespace->needs_load = true;
 	pg_namespace->needs_check = true;
+	pg_class->needs_rows = true;
+	pg_namespace->needs_rows = true;
 
 	/* Flag columns that must be loaded for this check. */
 	find_column_by_name(pg_namespace, "nspname")->needed = true;
 	find_column_by_name(pg_class, "relname")->needed = true;
 	find_column_by_name(pg_class, "relnamespace")->needed = true;
 	find_column_by_name(pg_class, "relkind")->needed = true;
+
+	/* We look up each relation's namespace by way of a join index. */
+	request_join_index(pg_class, find_column_by_name(pg_class, "relnamespace"),
+					   pg_namespace);
 }
 
 /*
@@ -47,13 +53,12 @@ perform_select_from_relations(PGconn *conn)
 {
 	PQExpBuffer query;
 	char	   *tablename,
-			   *nspname,
-			   *nspoid;
+			   *nspname;
+	int		   *nsp_rownums;
 	int			rownum;
 	int			ntups;
 	int			oid_result_column;
 	int			relname_result_column;
-	int			relnamespace_result_column;
 	int			relkind_result_column;
 	int			nspname_result_column;
 	pg_catalog_table *pg_class = find_table_by_name("pg_class");
@@ -63,17 +68,19 @@ perform_select_from_relations(PGconn *conn)
 	 * If we weren't able to retrieve the table data for either table, then
 	 * we can't run these checks.
 	 */
-	if (PQresultStatus(pg_class->data) != PGRES_TUPLES_OK ||
-		PQresultStatus(pg_namespace->data) != PGRES_TUPLES_OK)
+	if (pg_class->store == NULL || pg_namespace->store == NULL)
+		return;
+	nsp_rownums = get_join_index(pg_class,
+								 find_column_by_name(pg_class, "relnamespace"));
+	if (nsp_rownums == NULL)
 		return;
 
 	/* Locate the data we need. */
-	ntups = PQntuples(pg_class->data);
-	oid_result_column = PQfnumber(pg_class->data, "oid");
-	relname_result_column = PQfnumber(pg_class->data, "relname");
-	relnamespace_result_column = PQfnumber(pg_class->data, "relnamespace");
-	relkind_result_column = PQfnumber(pg_class->data, "relkind");
-	nspname_result_column = PQfnumber(pg_namespace->data, "nspname");
+	ntups = colstore_nrows(pg_class->store);
+	oid_result_column = colstore_fnumber(pg_class->store, "oid");
+	relname_result_column = colstore_fnumber(pg_class->store, "relname");
+	relkind_result_column = colstore_fnumber(pg_class->store, "relkind");
+	nspname_result_column = colstore_fnumber(pg_namespace->store, "nspname");
 
 	query = createPQExpBuffer();
 
@@ -85,27 +92,31 @@ perform_select_from_relations(PGconn *conn)
 		PGresult	   *qryres;
 
 		/* Check plain tables, toast tables, and materialized views. */
-		relkind = *(PQgetvalue(pg_class->data, rownum, relkind_result_column));
+		relkind = *(colstore_getvalue(pg_class->store, rownum,
+									  relkind_result_column));
 		if (relkind != 'r' && relkind != 't' && relkind != 'm')
 			continue;
 
-		/* Get the table name and namespace OID from the pg_class */
-		tablename = PQgetvalue(pg_class->data, rownum, relname_result_column);
-		nspoid = PQgetvalue(pg_class->data, rownum, relnamespace_result_column);
+		/* Get the table name from the pg_class */
+		tablename = colstore_getvalue(pg_class->store, rownum,
+									  relname_result_column);
 
 		/*
-		 * Get the namespace name for the given namespace OID. Any errors here
-		 * have already been reported, so we just emit a debug message here.
+		 * Get the namespace name for the table's namespace OID. Any errors
+		 * here have already been reported, so we just emit a debug message
+		 * here.
 		 */
-		nsp_rownum = pgrhash_get(pg_namespace->ht, &nspoid);
+		nsp_rownum = nsp_rownums[rownum];
 		if (nsp_rownum == -1)
 		{
 			pgcc_log(PGCC_DEBUG,
 					 "can't find schema name for select query for table with OID %s\n",
-					 PQgetvalue(pg_class->data, rownum, oid_result_column));
+					 colstore_getvalue(pg_class->store, rownum,
+									   oid_result_column));
 			continue;
 		}
-		nspname = PQgetvalue(pg_namespace->data, nsp_rownum, nspname_result_column);
+		nspname = colstore_getvalue(pg_namespace->store, nsp_rownum,
+									nspname_result_column);
 
 		/* Debug message. */
 		pgcc_log(PGCC_DEBUG, "selecting from \"%s\".\"%s\"\n", nspname, tablename);